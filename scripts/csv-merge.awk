@@ -0,0 +1,32 @@
+#!/usr/bin/awk -f
+#
+# Merges the CSV rows a benchmark prints into one file per table.
+#
+# Benchmarks print rows whose first field names their table, and the first
+# row of each table holds the column names. Each row is appended to
+# <outdir>/<table>.csv with the table name replaced by the config it came
+# from, so runs on several configs collect into one file. Lines that are
+# not CSV rows (e.g. the counters syscalls.c prints) are skipped.
+#
+# Variables (set with -v):
+#   config  name for the first column
+#   header  1 to write the column names, for the first config of a report
+#   outdir  directory for the <table>.csv files
+
+BEGIN {
+	FS = ","
+	if (outdir == "")
+		outdir = "."
+}
+
+NF < 2 || $1 !~ /^[a-z][a-z0-9-]*$/ { next }
+
+# First row of each table
+!($1 in seen) {
+	seen[$1] = 1
+	if (header)
+		print "config" substr($0, length($1) + 1) > (outdir "/" $1 ".csv")
+	next
+}
+
+{ print config substr($0, length($1) + 1) >> (outdir "/" $1 ".csv") }
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Content-addressed cache of elaboration outputs (.fir, .anno.json, .v).
+#
+#   elab-cache.sh hash EXTRA FILE...            print the sources key
+#   elab-cache.sh get CACHE KEY BUILD_DIR LONG_NAME
+#   elab-cache.sh put CACHE KEY BUILD_DIR LONG_NAME
+#
+# The key hashes EXTRA (generator and FIRRTL arguments) with the contents
+# of every source that goes into elaboration, so it survives touches,
+# checkouts and clean builds, and changes with any edit. Entries are stored per key and
+# per config long name (project.model.config). get exits non-zero on a
+# miss. Outputs are restored .fir first and .v last, so make sees the
+# Verilog as newer than the FIRRTL.
+
+set -e
+
+exts="fir anno.json v"
+
+case "$1" in
+hash)
+	extra=$2
+	shift 2
+	{ printf '%s\n' "$extra"; cat "$@"; } | sha1sum | cut -d' ' -f1
+	;;
+get)
+	entry=$2/$3/$5
+	[ -f "$entry/$5.v" ] || exit 1
+	for ext in $exts; do
+		cp "$entry/$5.$ext" "$4/$5.$ext.tmp"
+		mv "$4/$5.$ext.tmp" "$4/$5.$ext"
+	done
+	echo "elab-cache: $5 from $entry"
+	;;
+put)
+	entry=$2/$3/$5
+	mkdir -p "$2/$3"
+	tmp=$(mktemp -d "$2/$3/.tmp.XXXXXX")
+	for ext in $exts; do
+		cp "$4/$5.$ext" "$tmp/"
+	done
+	rm -rf "$entry"
+	mv "$tmp" "$entry"
+	;;
+*)
+	echo "usage: $0 hash|get|put ..." >&2
+	exit 2
+	;;
+esac
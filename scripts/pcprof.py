@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+#
+# Symbolizes a PC sample file from the Verilator simulator's +pc-sample
+# option (see verisim/csrc/pc-sampler.h) against the program's ELF.
+#
+#   pcprof.py tests/foo.riscv pcprof.bin
+#   pcprof.py tests/foo.riscv pcprof.bin --folded foo.folded
+#
+# Prints a flat profile of samples per function as CSV rows prefixed with
+# "pcprof", the first of which holds the column names: self is samples in
+# the function itself, total includes the functions it called. --folded
+# writes the call stacks in the folded format flamegraph.pl takes.
+
+import argparse
+import bisect
+import struct
+import sys
+
+STT_NOTYPE = 0
+STT_FUNC = 2
+STB_GLOBAL = 1
+
+
+def read_functions(path):
+    """Sorted (address, size, name) of the function symbols in a 64-bit
+    little-endian ELF."""
+    data = open(path, 'rb').read()
+    if data[:4] != b'\x7fELF' or data[4] != 2:
+        sys.exit('%s: not a 64-bit ELF' % path)
+    shoff, = struct.unpack_from('<Q', data, 0x28)
+    shentsize, shnum = struct.unpack_from('<HH', data, 0x3a)
+    sections = [struct.unpack_from('<IIQQQQIIQQ', data, shoff + i * shentsize)
+                for i in range(shnum)]
+
+    funcs = {}
+    labels = {}
+    for sh in sections:
+        if sh[1] != 2:  # SHT_SYMTAB
+            continue
+        strtab = sections[sh[6]]
+        for off in range(sh[4], sh[4] + sh[5], 24):
+            name, info, _, shndx, value, size = struct.unpack_from(
+                '<IBBHQQ', data, off)
+            if shndx == 0:
+                continue
+            start = strtab[4] + name
+            name = data[start:data.index(b'\0', start)].decode()
+            if info & 0xf == STT_FUNC:
+                funcs[value] = (value, size, name)
+            elif info & 0xf == STT_NOTYPE and info >> 4 == STB_GLOBAL:
+                labels[value] = (value, 0, name)
+
+    # Assembly entry points such as _start and trap_entry have no type, so
+    # they only count where no function starts
+    for value, label in labels.items():
+        funcs.setdefault(value, label)
+    return sorted(funcs.values())
+
+
+class Symbolizer:
+    def __init__(self, funcs):
+        self.funcs = funcs
+        self.addrs = [f[0] for f in funcs]
+        self.cache = {}
+
+    def __call__(self, pc):
+        name = self.cache.get(pc)
+        if name is None:
+            i = bisect.bisect_right(self.addrs, pc) - 1
+            if i < 0:
+                name = '0x%x' % pc
+            else:
+                addr, size, sym = self.funcs[i]
+                # Untyped labels have no size; trust them up to the next one
+                name = sym if (size == 0 or pc < addr + size) \
+                    else '0x%x' % pc
+            self.cache[pc] = name
+        return name
+
+
+def read_samples(path):
+    data = open(path, 'rb').read()
+    if data[:8] != b'PCSAMPL1':
+        sys.exit('%s: not a PC sample file' % path)
+    interval, = struct.unpack_from('<Q', data, 8)
+    off = 16
+    samples = []
+    while off + 16 <= len(data):
+        pc, depth, _ = struct.unpack_from('<QII', data, off)
+        off += 16
+        stack = struct.unpack_from('<%dQ' % depth, data, off)
+        off += 8 * depth
+        samples.append((pc, stack))
+    return interval, samples
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('elf')
+    parser.add_argument('samples')
+    parser.add_argument('--folded', help='write folded stacks here')
+    parser.add_argument('--top', type=int, default=0,
+                        help='only print this many functions')
+    args = parser.parse_args()
+
+    sym = Symbolizer(read_functions(args.elf))
+    interval, samples = read_samples(args.samples)
+    if not samples:
+        sys.exit('no samples')
+
+    self_counts = {}
+    total_counts = {}
+    folded = {}
+
+    for pc, stack in samples:
+        # A return address is just past its call, so look up the call
+        frames = [sym(ret - 2) for ret in stack] + [sym(pc)]
+        leaf = frames[-1]
+        self_counts[leaf] = self_counts.get(leaf, 0) + 1
+        for f in set(frames):
+            total_counts[f] = total_counts.get(f, 0) + 1
+        key = ';'.join(frames)
+        folded[key] = folded.get(key, 0) + 1
+
+    n = len(samples)
+    print('pcprof,function,self,self_pct_x100,total,total_pct_x100')
+    rows = sorted(total_counts, key=lambda f: (-self_counts.get(f, 0),
+                                               -total_counts[f], f))
+    if args.top:
+        rows = rows[:args.top]
+    for f in rows:
+        s = self_counts.get(f, 0)
+        t = total_counts[f]
+        print('pcprof,%s,%d,%d,%d,%d' % (f, s, s * 10000 // n,
+                                         t, t * 10000 // n))
+
+    if args.folded:
+        with open(args.folded, 'w') as out:
+            for key in sorted(folded):
+                out.write('%s %d\n' % (key, folded[key]))
+
+    sys.stderr.write('%d samples, one every %d cycles\n' % (n, interval))
+
+
+if __name__ == '__main__':
+    main()
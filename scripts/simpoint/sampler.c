@@ -0,0 +1,157 @@
+// Sampler for simpoint.py checkpoints. It runs from the machine timer
+// interrupt, every sample_tick mtime ticks: once sample_warmup
+// instructions have retired since the checkpoint it notes the cycle and
+// instruction counters, and once sample_length more have retired it prints
+// the difference and ends the simulation.
+//
+// The counters are only checked on a tick, so each phase runs slightly
+// long. That does not matter, since the CPI comes from what the counters
+// actually saw.
+//
+// The program must not take any other trap, or turn off the timer
+// interrupt, while it is being sampled.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CLINT_BASE 0x02000000UL
+#define CLINT_MTIMECMP (CLINT_BASE + 0x4000)
+#define CLINT_MTIME (CLINT_BASE + 0xbff8)
+
+#define IRQ_M_TIMER 7
+#define MCAUSE_INT (1UL << 63)
+
+#define SYS_write 64
+
+#define read_csr(reg) ({ unsigned long __tmp; \
+  asm volatile ("csrr %0, " #reg : "=r"(__tmp)); \
+  __tmp; })
+
+extern volatile uint64_t tohost, fromhost;
+
+extern uint64_t sample_id, sample_warmup, sample_length, sample_tick;
+
+static uint64_t base_inst, warm_cycle, warm_inst;
+static int measuring;
+
+static void set_timer(void)
+{
+	volatile uint64_t *mtime = (volatile uint64_t *) CLINT_MTIME;
+	volatile uint64_t *mtimecmp = (volatile uint64_t *) CLINT_MTIMECMP;
+
+	*mtimecmp = *mtime + sample_tick;
+}
+
+static void start_measuring(void)
+{
+	warm_cycle = read_csr(mcycle);
+	warm_inst = read_csr(minstret);
+	measuring = 1;
+}
+
+// Same host call protocol as tests/syscalls.c
+static void htif_write(const char *buf, size_t len)
+{
+	static volatile uint64_t magic_mem[8] __attribute__((aligned(64)));
+
+	magic_mem[0] = SYS_write;
+	magic_mem[1] = 1;
+	magic_mem[2] = (uintptr_t) buf;
+	magic_mem[3] = len;
+	__sync_synchronize();
+
+	tohost = (uintptr_t) magic_mem;
+	while (fromhost == 0)
+		;
+	fromhost = 0;
+	__sync_synchronize();
+}
+
+static void __attribute__((noreturn)) htif_exit(int code)
+{
+	tohost = (code << 1) | 1;
+	for (;;)
+		;
+}
+
+static char *put_str(char *p, const char *s)
+{
+	while (*s)
+		*p++ = *s++;
+	return p;
+}
+
+static char *put_u64(char *p, uint64_t v)
+{
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	while (n)
+		*p++ = digits[--n];
+	return p;
+}
+
+static void report(const char *table, const char *header,
+		const uint64_t *vals, int nvals)
+{
+	char buf[256];
+	char *p = buf;
+	int i;
+
+	p = put_str(p, table);
+	p = put_str(p, header);
+	p = put_str(p, table);
+	for (i = 0; i < nvals; i++) {
+		*p++ = ',';
+		p = put_u64(p, vals[i]);
+	}
+	*p++ = '\n';
+
+	htif_write(buf, p - buf);
+}
+
+void sample_init(void)
+{
+	base_inst = read_csr(minstret);
+	measuring = 0;
+	if (sample_warmup == 0)
+		start_measuring();
+	set_timer();
+}
+
+void sample_handle_trap(void)
+{
+	uint64_t cause = read_csr(mcause);
+	uint64_t vals[4];
+	uint64_t n;
+
+	if (cause != (MCAUSE_INT | IRQ_M_TIMER)) {
+		vals[0] = sample_id;
+		vals[1] = cause;
+		vals[2] = read_csr(mepc);
+		report("simpoint-error", ",interval,mcause,mepc\n", vals, 3);
+		htif_exit(3);
+	}
+
+	n = read_csr(minstret) - base_inst;
+
+	if (!measuring && n >= sample_warmup)
+		start_measuring();
+
+	if (measuring && n >= sample_warmup + sample_length) {
+		vals[0] = sample_id;
+		vals[1] = warm_inst - base_inst;
+		vals[2] = read_csr(minstret) - warm_inst;
+		vals[3] = read_csr(mcycle) - warm_cycle;
+		report("simpoint-sample",
+			",interval,warmup_insts,insts,cycles\n", vals, 4);
+		htif_exit(0);
+	}
+
+	set_timer();
+}
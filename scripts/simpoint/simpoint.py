@@ -0,0 +1,620 @@
+#!/usr/bin/env python3
+#
+# SimPoint-style sampled simulation.
+#
+# A program is profiled once on spike, its basic block vectors are
+# clustered, and only a few intervals per cluster are run on the RTL
+# simulator. Each of those starts from a checkpoint ELF holding the
+# program's memory and registers at that point, plus a small restore stub
+# (restore.S, sampler.c) that puts the state back and reports the cycles
+# and instructions of the interval. The per-cluster CPIs are then weighted
+# up to an estimate of the whole run.
+#
+#   profile     commit log on stdin -> basic block vectors
+#   cluster     basic block vectors -> simpoints.csv
+#   checkpoint  commit log on stdin + simpoints.csv -> ckpt-<n>.riscv
+#   estimate    simpoints.csv + sample output -> total cycle estimate
+#
+# The commit log comes from spike --log-commits on stderr. Only hart 0 is
+# followed. See the simpoint target in verisim/Makefile for the whole flow.
+
+import argparse
+import math
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+
+DRAM_BASE = 0x80000000
+PAGE_SHIFT = 12
+PAGE_SIZE = 1 << PAGE_SHIFT
+
+COMMIT_RE = re.compile(
+    r'^core\s+(\d+):\s+(?:\d\s+)?0x([0-9a-f]+)\s+\(0x([0-9a-f]+)\)(.*)$')
+XREG_RE = re.compile(r'^x(\d+)$')
+FREG_RE = re.compile(r'^f(\d+)$')
+CSR_RE = re.compile(r'^c(\d+)(?:_\w+)?$')
+
+CSR_FFLAGS = 0x001
+CSR_FRM = 0x002
+CSR_FCSR = 0x003
+CSR_MSTATUS = 0x300
+CSR_MIE = 0x304
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def commits(f):
+    """Yields (pc, insn length, list of (kind, ...) writes) per retired
+    instruction on hart 0."""
+    for line in f:
+        m = COMMIT_RE.match(line)
+        if not m or m.group(1) != '0':
+            continue
+        pc = int(m.group(2), 16)
+        length = len(m.group(3)) // 2
+        yield pc, length, m.group(4).split()
+
+
+def parse_writes(tokens):
+    i = 0
+    while i < len(tokens):
+        tok = tokens[i]
+        if tok == 'mem':
+            addr = int(tokens[i + 1], 16)
+            if i + 2 < len(tokens) and tokens[i + 2].startswith('0x'):
+                val = tokens[i + 2]
+                yield ('mem', addr, int(val, 16), (len(val) - 2) // 2)
+                i += 3
+            else:
+                i += 2
+            continue
+        m = XREG_RE.match(tok) or FREG_RE.match(tok) or CSR_RE.match(tok)
+        if m and i + 1 < len(tokens):
+            yield (tok[0], int(m.group(1)), int(tokens[i + 1], 16))
+            i += 2
+            continue
+        i += 1
+
+
+# --- profile ----------------------------------------------------------------
+
+def cmd_profile(args):
+    """Splits the run into intervals of args.interval instructions and
+    counts the instructions executed in each basic block, writing one
+    SimPoint-format line ("T:block:count ...") per interval."""
+    blocks = {}
+    bbv = {}
+    count = 0
+    total = 0
+    block = None
+    next_pc = None
+
+    out = open(args.output, 'w')
+
+    def flush():
+        items = sorted(bbv.items())
+        out.write('T' + ' '.join(':%d:%d' % kv for kv in items) + '\n')
+        bbv.clear()
+
+    for pc, length, _ in commits(sys.stdin):
+        # A block starts wherever control did not fall through
+        if pc != next_pc:
+            block = blocks.setdefault(pc, len(blocks) + 1)
+        next_pc = pc + length
+        bbv[block] = bbv.get(block, 0) + 1
+        count += 1
+        total += 1
+        if count == args.interval:
+            flush()
+            count = 0
+
+    if count:
+        flush()
+    out.close()
+
+    sys.stderr.write('%d instructions, %d blocks\n' % (total, len(blocks)))
+
+
+# --- cluster ----------------------------------------------------------------
+
+def read_bbv(path):
+    vectors = []
+    for line in open(path):
+        line = line.strip()
+        if not line.startswith('T'):
+            continue
+        vec = {}
+        for field in line[1:].split():
+            _, block, n = field.split(':')
+            vec[int(block)] = int(n)
+        vectors.append(vec)
+    return vectors
+
+
+def project(vectors, dims, seed):
+    """Normalizes each vector and projects it down to dims dimensions with
+    a random matrix, as SimPoint does."""
+    rng = random.Random(seed)
+    columns = {}
+    points = []
+    for vec in vectors:
+        total = float(sum(vec.values()))
+        p = [0.0] * dims
+        for block, n in vec.items():
+            col = columns.get(block)
+            if col is None:
+                col = [rng.uniform(-1, 1) for _ in range(dims)]
+                columns[block] = col
+            w = n / total
+            for d in range(dims):
+                p[d] += w * col[d]
+        points.append(p)
+    return points
+
+
+def dist2(a, b):
+    return sum((x - y) * (x - y) for x, y in zip(a, b))
+
+
+def kmeans(points, k, rng, iters=100):
+    # k-means++ seeding
+    centers = [list(rng.choice(points))]
+    while len(centers) < k:
+        d = [min(dist2(p, c) for c in centers) for p in points]
+        total = sum(d)
+        if total == 0:
+            break
+        r = rng.uniform(0, total)
+        for p, dp in zip(points, d):
+            r -= dp
+            if r <= 0:
+                centers.append(list(p))
+                break
+
+    assign = [0] * len(points)
+    for _ in range(iters):
+        changed = False
+        for i, p in enumerate(points):
+            best = min(range(len(centers)), key=lambda c: dist2(p, centers[c]))
+            if best != assign[i]:
+                assign[i] = best
+                changed = True
+        for c in range(len(centers)):
+            members = [points[i] for i in range(len(points)) if assign[i] == c]
+            if members:
+                centers[c] = [sum(x) / len(members) for x in zip(*members)]
+        if not changed:
+            break
+    return centers, assign
+
+
+def bic(points, centers, assign):
+    """Bayesian information criterion of a clustering, for spherical
+    Gaussians (Pelleg and Moore, as used by SimPoint)."""
+    r = len(points)
+    k = len(centers)
+    m = len(points[0])
+    if r <= k:
+        return float('-inf')
+    var = sum(dist2(p, centers[assign[i]]) for i, p in enumerate(points))
+    var /= (r - k)
+    if var <= 0:
+        return float('inf')
+    loglik = 0.0
+    for c in range(k):
+        rc = sum(1 for a in assign if a == c)
+        if rc == 0:
+            continue
+        loglik += (rc * math.log(rc) - rc * math.log(r)
+                   - rc * m / 2.0 * math.log(2 * math.pi * var)
+                   - (rc - 1) * m / 2.0)
+    params = (k - 1) + m * k + 1
+    return loglik - params / 2.0 * math.log(r)
+
+
+def cmd_cluster(args):
+    vectors = read_bbv(args.bbv)
+    if not vectors:
+        sys.exit('%s: no intervals' % args.bbv)
+    sizes = [sum(v.values()) for v in vectors]
+    total = sum(sizes)
+    points = project(vectors, args.dims, args.seed)
+
+    # Like SimPoint, take the smallest k whose score is within 90% of the
+    # best seen
+    results = []
+    for k in range(1, min(args.maxk, len(points)) + 1):
+        rng = random.Random(args.seed + k)
+        centers, assign = kmeans(points, k, rng)
+        results.append((k, bic(points, centers, assign), centers, assign))
+    scores = [r[1] for r in results if math.isfinite(r[1])]
+    if scores:
+        lo, hi = min(scores), max(scores)
+        threshold = lo + 0.9 * (hi - lo)
+        chosen = next(r for r in results
+                      if r[1] == float('inf') or r[1] >= threshold)
+    else:
+        chosen = results[0]
+    k, _, centers, assign = chosen
+
+    rng = random.Random(args.seed)
+    with open(args.output, 'w') as out:
+        out.write('simpoint-info,total_insts,interval,intervals,clusters\n')
+        out.write('simpoint-info,%d,%d,%d,%d\n' %
+                  (total, args.interval, len(vectors), k))
+        out.write('simpoint,cluster,interval,insts,weight,role\n')
+        for c in range(len(centers)):
+            members = [i for i in range(len(points)) if assign[i] == c]
+            if not members:
+                continue
+            weight = sum(sizes[i] for i in members) / float(total)
+            members.sort(key=lambda i: dist2(points[i], centers[c]))
+            rep = members[0]
+            # Extra random members give a spread to put error bounds on
+            extras = rng.sample(members[1:],
+                                min(args.samples - 1, len(members) - 1))
+            out.write('simpoint,%d,%d,%d,%.6f,rep\n' %
+                      (c, rep, sizes[rep], weight))
+            for i in sorted(extras):
+                out.write('simpoint,%d,%d,%d,%.6f,extra\n' %
+                          (c, i, sizes[i], weight))
+
+    sys.stderr.write('%d intervals in %d clusters\n' % (len(vectors), k))
+
+
+def read_simpoints(path):
+    info = None
+    points = []
+    for line in open(path):
+        f = line.strip().split(',')
+        if f[0] == 'simpoint-info' and f[1] != 'total_insts':
+            info = {'total_insts': int(f[1]), 'interval': int(f[2])}
+        elif f[0] == 'simpoint' and f[1] != 'cluster':
+            points.append({'cluster': int(f[1]), 'interval': int(f[2]),
+                           'insts': int(f[3]), 'weight': float(f[4])})
+    if info is None:
+        sys.exit('%s: no simpoint-info row' % path)
+    return info, points
+
+
+# --- checkpoint -------------------------------------------------------------
+
+def read_elf(path):
+    """Returns the loadable segments as (vaddr, bytes, memsz) and the
+    symbol table of a 64-bit little-endian ELF."""
+    data = open(path, 'rb').read()
+    if data[:4] != b'\x7fELF' or data[4] != 2:
+        sys.exit('%s: not a 64-bit ELF' % path)
+    (phoff, shoff) = struct.unpack_from('<QQ', data, 0x20)
+    (phentsize, phnum, shentsize, shnum) = struct.unpack_from(
+        '<HHHH', data, 0x36)
+
+    segments = []
+    for i in range(phnum):
+        (ptype, _, offset, vaddr, _, filesz, memsz, _) = struct.unpack_from(
+            '<IIQQQQQQ', data, phoff + i * phentsize)
+        if ptype == 1:
+            segments.append((vaddr, data[offset:offset + filesz], memsz))
+
+    symbols = {}
+    sections = [struct.unpack_from('<IIQQQQIIQQ', data, shoff + i * shentsize)
+                for i in range(shnum)]
+    for sh in sections:
+        if sh[1] != 2:  # SHT_SYMTAB
+            continue
+        strtab = sections[sh[6]]
+        for off in range(sh[4], sh[4] + sh[5], 24):
+            (name, _, _, _, value, _) = struct.unpack_from(
+                '<IBBHQQ', data, off)
+            start = strtab[4] + name
+            end = data.index(b'\0', start)
+            symbols[data[start:end].decode()] = value
+    return segments, symbols
+
+
+class State:
+    def __init__(self, segments):
+        self.x = [0] * 32
+        self.f = [0] * 32
+        self.csr = {}
+        self.fcsr = 0
+        self.pages = {}
+        for vaddr, data, memsz in segments:
+            self.write_bytes(vaddr, data + bytes(memsz - len(data)))
+
+    def page(self, addr):
+        pn = addr >> PAGE_SHIFT
+        p = self.pages.get(pn)
+        if p is None:
+            p = self.pages[pn] = bytearray(PAGE_SIZE)
+        return p
+
+    def write_bytes(self, addr, data):
+        i = 0
+        while i < len(data):
+            a = addr + i
+            off = a & (PAGE_SIZE - 1)
+            n = min(PAGE_SIZE - off, len(data) - i)
+            self.page(a)[off:off + n] = data[i:i + n]
+            i += n
+
+    def apply(self, writes):
+        for w in writes:
+            if w[0] == 'x':
+                if w[1]:
+                    self.x[w[1]] = w[2]
+            elif w[0] == 'f':
+                self.f[w[1]] = w[2] & ((1 << 64) - 1)
+            elif w[0] == 'c':
+                csr, val = w[1], w[2]
+                if csr == CSR_FFLAGS:
+                    self.fcsr = (self.fcsr & ~0x1f) | (val & 0x1f)
+                elif csr == CSR_FRM:
+                    self.fcsr = (self.fcsr & ~0xe0) | ((val & 7) << 5)
+                elif csr == CSR_FCSR:
+                    self.fcsr = val & 0xff
+                else:
+                    self.csr[csr] = val
+            elif w[0] == 'mem' and w[1] >= DRAM_BASE:
+                self.write_bytes(w[1], w[2].to_bytes(w[3], 'little'))
+
+    def runs(self):
+        """Contiguous runs of pages, as (address, bytearray)."""
+        runs = []
+        for pn in sorted(self.pages):
+            if pn < (DRAM_BASE >> PAGE_SHIFT):
+                continue
+            if runs and runs[-1][0] + len(runs[-1][1]) == pn << PAGE_SHIFT:
+                runs[-1][1].extend(self.pages[pn])
+            else:
+                runs.append((pn << PAGE_SHIFT, bytearray(self.pages[pn])))
+        return runs
+
+
+def jump_to(offset):
+    """auipc t0, hi; jalr zero, lo(t0)"""
+    hi = (offset + 0x800) >> 12
+    lo = offset - (hi << 12)
+    auipc = ((hi & 0xfffff) << 12) | (5 << 7) | 0x17
+    jalr = ((lo & 0xfff) << 20) | (5 << 15) | 0x67
+    return struct.pack('<II', auipc, jalr)
+
+
+def dwords(name, values):
+    return ('  .globl %s\n%s:\n' % (name, name) +
+            ''.join('  .dword 0x%x\n' % v for v in values))
+
+
+def write_checkpoint(args, state, pc, symbols, sample):
+    name = 'ckpt-%d' % sample['interval']
+    base = os.path.join(args.outdir, name)
+    runs = state.runs()
+
+    # The stub goes above everything the program has touched, and the
+    # boot ROM's jump to DRAM_BASE is pointed at it
+    top = max(addr + len(data) for addr, data in runs)
+    stub_base = (top + 0xffff) & ~0xffff
+    first = runs[0]
+    if first[0] != DRAM_BASE:
+        sys.exit('%s: nothing loaded at 0x%x' % (args.elf, DRAM_BASE))
+    orig = bytes(first[1][:8])
+    first[1][:8] = jump_to(stub_base - DRAM_BASE)
+
+    # A half-finished host call would be replayed
+    for sym in ('tohost', 'fromhost'):
+        if sym in symbols:
+            addr = symbols[sym]
+            for a, data in runs:
+                if a <= addr < a + len(data):
+                    data[addr - a:addr - a + 8] = bytes(8)
+
+    asm = ['  .section .data.ckpt, "aw"\n', '  .align 3\n']
+    asm.append(dwords('ckpt_x', state.x))
+    asm.append(dwords('ckpt_f', state.f))
+    asm.append(dwords('ckpt_fcsr', [state.fcsr]))
+    asm.append(dwords('ckpt_mstatus', [state.csr.get(CSR_MSTATUS, 0)]))
+    asm.append(dwords('ckpt_mie', [state.csr.get(CSR_MIE, 0)]))
+    asm.append(dwords('ckpt_pc', [pc]))
+    asm.append(dwords('ckpt_orig_insts',
+                      [struct.unpack('<Q', orig)[0]]))
+    asm.append(dwords('sample_id', [sample['interval']]))
+    asm.append(dwords('sample_warmup', [sample['warmup']]))
+    asm.append(dwords('sample_length', [sample['insts']]))
+    asm.append(dwords('sample_tick', [args.tick]))
+
+    ld = ['OUTPUT_ARCH("riscv")\n', 'ENTRY(ckpt_entry)\n', 'SECTIONS\n{\n']
+    for i, (addr, data) in enumerate(runs):
+        binfile = '%s.seg%d.bin' % (base, i)
+        with open(binfile, 'wb') as f:
+            f.write(data)
+        asm.append('  .section .ckpt%d, "aw", @progbits\n'
+                   '  .incbin "%s"\n' % (i, os.path.abspath(binfile)))
+        ld.append('  .ckpt%d 0x%x : { KEEP(*(.ckpt%d)) }\n' % (i, addr, i))
+    # Everything of the stub's, including its stack, is initialized data:
+    # the loader does not clear memory
+    ld.append('  .stub 0x%x : {\n'
+              '    KEEP(*(.text.ckpt_entry))\n'
+              '    *(.text .text.*)\n'
+              '    *(.rodata .rodata.* .srodata .srodata.*)\n'
+              '    *(.data .data.* .sdata .sdata.*)\n'
+              '    *(.bss .bss.* .sbss .sbss.* COMMON)\n'
+              '  }\n' % stub_base)
+    for sym in ('tohost', 'fromhost'):
+        ld.append('  %s = 0x%x;\n' % (sym, symbols[sym]))
+    ld.append('}\n')
+
+    with open(base + '.S', 'w') as f:
+        f.write(''.join(asm))
+    with open(base + '.ld', 'w') as f:
+        f.write(''.join(ld))
+
+    cmd = args.gcc.split() + [
+        '-march=rv64gc', '-mabi=lp64d', '-mcmodel=medany', '-O2',
+        '-static', '-nostdlib', '-nostartfiles',
+        '-T', base + '.ld', '-o', base + '.riscv', base + '.S',
+        os.path.join(SCRIPT_DIR, 'restore.S'),
+        os.path.join(SCRIPT_DIR, 'sampler.c')]
+    subprocess.check_call(cmd)
+    sys.stderr.write('%s.riscv: pc 0x%x, %d warm-up + %d instructions\n' %
+                     (base, pc, sample['warmup'], sample['insts']))
+
+
+def cmd_checkpoint(args):
+    info, points = read_simpoints(args.simpoints)
+    segments, symbols = read_elf(args.elf)
+    for sym in ('tohost', 'fromhost'):
+        if sym not in symbols:
+            sys.exit('%s: no %s symbol' % (args.elf, sym))
+
+    os.makedirs(args.outdir, exist_ok=True)
+    state = State(segments)
+
+    # The checkpoint is taken the warm-up length ahead of the interval
+    samples = {}
+    for p in points:
+        start = p['interval'] * info['interval']
+        samples[p['interval']] = dict(p, start=start)
+    pending = sorted(samples.values(), key=lambda s: s['start'])
+
+    index = 0
+    first_dram = None
+    for pc, _, tokens in commits(sys.stdin):
+        # Harts start in spike's own boot ROM, which the RTL does not have
+        if first_dram is None and pc >= DRAM_BASE:
+            first_dram = index
+        while first_dram is not None and pending:
+            s = pending[0]
+            at = max(first_dram, s['start'] - args.warmup)
+            if at > index:
+                break
+            # An interval that starts in the boot ROM loses that part
+            if s['start'] < index:
+                s['insts'] -= index - s['start']
+                s['start'] = index
+            s['warmup'] = s['start'] - index
+            write_checkpoint(args, state, pc, symbols, s)
+            pending.pop(0)
+        if not pending:
+            break
+        state.apply(parse_writes(tokens))
+        index += 1
+
+    if pending:
+        sys.exit('log ended before interval %d' % pending[0]['interval'])
+
+
+# --- estimate ---------------------------------------------------------------
+
+def cmd_estimate(args):
+    info, points = read_simpoints(args.simpoints)
+
+    measured = {}
+    for path in args.samples:
+        for line in open(path):
+            f = line.strip().split(',')
+            if f[0] == 'simpoint-sample' and f[1] != 'interval':
+                insts, cycles = int(f[3]), int(f[4])
+                if insts:
+                    measured[int(f[1])] = cycles / float(insts)
+
+    clusters = {}
+    for p in points:
+        c = clusters.setdefault(p['cluster'], {'weight': p['weight'],
+                                               'cpis': []})
+        if p['interval'] in measured:
+            c['cpis'].append(measured[p['interval']])
+        else:
+            sys.stderr.write('no sample for interval %d\n' % p['interval'])
+
+    # Clusters without a sample are left out and the rest reweighted
+    covered = dict((k, c) for k, c in clusters.items() if c['cpis'])
+    if not covered:
+        sys.exit('no samples')
+    weight_sum = sum(c['weight'] for c in covered.values())
+
+    # Stratified sampling: CPI is the weighted mean of the cluster means,
+    # and its variance the weighted sum of the variances of those means.
+    # Clusters with one sample take the pooled relative variance of the
+    # others.
+    cpi = 0.0
+    rel_vars = []
+    for c in covered.values():
+        c['w'] = c['weight'] / weight_sum
+        n = len(c['cpis'])
+        c['mean'] = sum(c['cpis']) / n
+        cpi += c['w'] * c['mean']
+        if n > 1:
+            c['var'] = sum((x - c['mean']) ** 2 for x in c['cpis']) / (n - 1)
+            rel_vars.append(c['var'] / (c['mean'] ** 2))
+    pooled = sum(rel_vars) / len(rel_vars) if rel_vars else None
+
+    var = 0.0
+    for c in covered.values():
+        v = c.get('var')
+        if v is None:
+            if pooled is None:
+                var = None
+                break
+            v = pooled * c['mean'] ** 2
+        var += c['w'] ** 2 * v / len(c['cpis'])
+
+    total = info['total_insts']
+    cycles = cpi * total
+    print('simpoint-estimate,total_insts,cpi_x1000,est_cycles,ci95_low,'
+          'ci95_high,ci95_pct,clusters,clusters_sampled,samples')
+    if var is None:
+        low = high = pct = 'nan'
+    else:
+        half = 1.96 * math.sqrt(var) * total
+        low, high = '%d' % (cycles - half), '%d' % (cycles + half)
+        pct = '%.2f' % (100.0 * half / cycles)
+    print('simpoint-estimate,%d,%d,%d,%s,%s,%s,%d,%d,%d' % (
+        total, cpi * 1000, cycles, low, high, pct, len(clusters),
+        len(covered), sum(len(c['cpis']) for c in covered.values())))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    sub = parser.add_subparsers(dest='cmd')
+    sub.required = True
+
+    p = sub.add_parser('profile')
+    p.add_argument('--interval', type=int, default=1000000)
+    p.add_argument('-o', '--output', required=True)
+    p.set_defaults(func=cmd_profile)
+
+    p = sub.add_parser('cluster')
+    p.add_argument('bbv')
+    p.add_argument('--interval', type=int, default=1000000)
+    p.add_argument('--maxk', type=int, default=10)
+    p.add_argument('--dims', type=int, default=15)
+    p.add_argument('--samples', type=int, default=2,
+                   help='intervals run per cluster')
+    p.add_argument('--seed', type=int, default=1)
+    p.add_argument('-o', '--output', required=True)
+    p.set_defaults(func=cmd_cluster)
+
+    p = sub.add_parser('checkpoint')
+    p.add_argument('simpoints')
+    p.add_argument('--elf', required=True)
+    p.add_argument('--warmup', type=int, default=100000)
+    p.add_argument('--tick', type=int, default=100,
+                   help='mtime ticks between sampler checks')
+    p.add_argument('--gcc', default='riscv64-unknown-elf-gcc')
+    p.add_argument('-o', '--outdir', required=True)
+    p.set_defaults(func=cmd_checkpoint)
+
+    p = sub.add_parser('estimate')
+    p.add_argument('simpoints')
+    p.add_argument('samples', nargs='+')
+    p.set_defaults(func=cmd_estimate)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,6 +1,7 @@
 package boomexample
 
 import chisel3._
+import example.{TraceTap, TrafficTap, TrafficTaps}
 import freechips.rocketchip.diplomacy.LazyModule
 import freechips.rocketchip.config.{Field, Parameters}
 import freechips.rocketchip.util.GeneratorApp
@@ -10,6 +11,8 @@ case object BuildBoomTop extends Field[(Clock, Bool, Parameters) => BoomExampleT
 class TestHarness(implicit val p: Parameters) extends Module {
   val io = IO(new Bundle {
     val success = Output(Bool())
+    val trace = Output(new TraceTap)
+    val traffic = Output(new TrafficTaps)
   })
 
   val dut = p(BuildBoomTop)(clock, reset.toBool, p)
@@ -18,6 +21,16 @@ class TestHarness(implicit val p: Parameters) extends Module {
   dut.dontTouchPorts()
   dut.tieOffInterrupts()
   io.success := dut.connectSimSerial()
+  // Same ports as example.TestHarness, which the Verilator harness expects
+  io.trace.valid := false.B
+  io.trace.pc := 0.U
+  io.trace.insn := 0.U
+  io.trace.slot := 0.U
+  io.traffic.mem := TrafficTap(dut.mem_axi4.head)
+  TrafficTap.tieOff(io.traffic.core)
+  TrafficTap.tieOff(io.traffic.blkdev)
+  TrafficTap.tieOff(io.traffic.icenic)
+  io.traffic.events := 0.U.asTypeOf(io.traffic.events)
 }
 
 object Generator extends GeneratorApp {
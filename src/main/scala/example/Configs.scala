@@ -5,7 +5,7 @@ import freechips.rocketchip.config.{Parameters, Config}
 import freechips.rocketchip.subsystem.{WithRoccExample, WithNMemoryChannels, WithNBigCores, WithRV32}
 import freechips.rocketchip.devices.tilelink.BootROMParams
 import freechips.rocketchip.diplomacy.{LazyModule, ValName}
-import freechips.rocketchip.tile.XLen
+import freechips.rocketchip.tile.{BuildRoCC, OpcodeSet, XLen}
 import testchipip._
 import icenet._
 
@@ -55,6 +55,12 @@ class WithLoopbackNIC extends Config((site, here, up) => {
   }
 })
 
+// Applied on top of WithLoopbackNIC or WithSimNetwork to size the NIC's
+// receive buffer, e.g. to move the backpressure knee tests/nic-bench.c finds
+class WithNICInBufPackets(n: Int) extends Config((site, here, up) => {
+  case NICKey => up(NICKey, site).copy(inBufPackets = n)
+})
+
 class WithSimNetwork extends Config((site, here, up) => {
   case NICKey => NICConfig(inBufPackets = 10)
   case BuildTop => (clock: Clock, reset: Bool, p: Parameters) => {
@@ -64,6 +70,18 @@ class WithSimNetwork extends Config((site, here, up) => {
   }
 })
 
+// Every MMIO device on one periphery bus, for tests/mmio-bench.c. The block
+// device and NIC use their internal models, so no image or tap is needed.
+class WithMMIODevices extends Config((site, here, up) => {
+  case NICKey => NICConfig(inBufPackets = 10)
+  case BuildTop => (clock: Clock, reset: Bool, p: Parameters) => {
+    val top = Module(LazyModule(new ExampleTopWithMMIODevices()(p)).module)
+    top.connectBlockDeviceModel()
+    top.connectNicLoopback()
+    top
+  }
+})
+
 class BaseExampleConfig extends Config(
   new WithBootROM ++
   new freechips.rocketchip.system.DefaultConfig)
@@ -71,11 +89,31 @@ class BaseExampleConfig extends Config(
 class DefaultExampleConfig extends Config(
   new WithExampleTop ++ new BaseExampleConfig)
 
+// Adds the streaming character counter on custom3, which WithRoccExample
+// leaves free
+class WithStreamingCharCount extends Config((site, here, up) => {
+  case BuildRoCC => up(BuildRoCC, site) :+ ((p: Parameters) =>
+    LazyModule(new StreamingCharCount(OpcodeSet.custom3)(p)))
+})
+
+// memcpy/memset engine. It defaults to custom3, so it cannot be combined
+// with RoccExampleConfig without moving it to another opcode.
+class WithRoccDMA(opcodes: OpcodeSet = OpcodeSet.custom3) extends Config((site, here, up) => {
+  case BuildRoCC => up(BuildRoCC, site) :+ ((p: Parameters) =>
+    LazyModule(new RoccDMA(opcodes)(p)))
+})
+
 class RoccExampleConfig extends Config(
-  new WithRoccExample ++ new DefaultExampleConfig)
+  new WithStreamingCharCount ++ new WithRoccExample ++ new DefaultExampleConfig)
+
+class RoccDMAConfig extends Config(
+  new WithRoccDMA ++ new DefaultExampleConfig)
 
 class PWMConfig extends Config(new WithPWM ++ new BaseExampleConfig)
 
+class MMIOBenchConfig extends Config(
+  new WithBlockDevice ++ new WithMMIODevices ++ new BaseExampleConfig)
+
 class SimBlockDeviceConfig extends Config(
   new WithBlockDevice ++ new WithSimBlockDevice ++ new BaseExampleConfig)
 
@@ -85,18 +123,42 @@ class BlockDeviceModelConfig extends Config(
 class LoopbackNICConfig extends Config(
   new WithLoopbackNIC ++ new BaseExampleConfig)
 
+class SmallBufLoopbackNICConfig extends Config(
+  new WithNICInBufPackets(4) ++ new LoopbackNICConfig)
+
 class SimNetworkConfig extends Config(
   new WithSimNetwork ++ new BaseExampleConfig)
 
 class WithTwoTrackers extends WithNBlockDeviceTrackers(2)
 class WithFourTrackers extends WithNBlockDeviceTrackers(4)
 
+class TwoTrackerSimBlockDeviceConfig extends Config(
+  new WithTwoTrackers ++ new SimBlockDeviceConfig)
+
+class FourTrackerSimBlockDeviceConfig extends Config(
+  new WithFourTrackers ++ new SimBlockDeviceConfig)
+
+class TwoTrackerBlockDeviceModelConfig extends Config(
+  new WithTwoTrackers ++ new BlockDeviceModelConfig)
+
+class FourTrackerBlockDeviceModelConfig extends Config(
+  new WithFourTrackers ++ new BlockDeviceModelConfig)
+
 class WithTwoMemChannels extends WithNMemoryChannels(2)
 class WithFourMemChannels extends WithNMemoryChannels(4)
 
+class TwoMemChannelConfig extends Config(
+  new WithTwoMemChannels ++ new DefaultExampleConfig)
+
+class FourMemChannelConfig extends Config(
+  new WithFourMemChannels ++ new DefaultExampleConfig)
+
 class DualCoreConfig extends Config(
   // Core gets tacked onto existing list
   new WithNBigCores(1) ++ new DefaultExampleConfig)
 
+class QuadCoreConfig extends Config(
+  new WithNBigCores(3) ++ new DefaultExampleConfig)
+
 class RV32ExampleConfig extends Config(
   new WithRV32 ++ new DefaultExampleConfig)
@@ -0,0 +1,46 @@
+package example
+
+import java.io.File
+import freechips.rocketchip.util.GeneratorApp
+
+// One elaboration, as done by each project's Generator, run on demand
+// rather than as a program
+class GeneratorRun extends GeneratorApp {
+  val longName = names.topModuleProject + "." + names.topModuleClass + "." + names.configs
+  generateFirrtl
+  generateAnno
+}
+
+// Elaborates several configs in one JVM, and compiles each to Verilog with
+// FIRRTL in the same JVM, instead of starting SBT and FIRRTL once per
+// config. Arguments are those of Generator with any number of configs:
+//
+//   runMain example.MultiGenerator <targetDir> <topProject> <topClass> <configProject> <config>...
+//
+// Each config produces the same .fir, .anno.json and .v files that
+// Generator and the FIRRTL rule in Makefrag would, with the same transforms
+// (FIRRTL_TRANSFORMS in Makefrag).
+object MultiGenerator {
+  def main(args: Array[String]): Unit = {
+    require(args.size >= 5, "Usage: MultiGenerator " +
+      "<targetDir> <topProject> <topClass> <configProject> <config>...")
+    val Array(targetDir, topProject, topClass, configProject) = args.take(4)
+
+    for (config <- args.drop(4)) {
+      new GeneratorRun().main(Array(targetDir, topProject, topClass, configProject, config))
+
+      val base = new File(targetDir, s"$topProject.$topClass.$config").toString
+      val result = firrtl.Driver.execute(Array(
+        "-i", base + ".fir",
+        "-o", base + ".v",
+        "-X", "verilog",
+        "-faf", base + ".anno.json",
+        "-fct", "firrtl.passes.wiring.WiringTransform"))
+      result match {
+        case _: firrtl.FirrtlExecutionSuccess =>
+        case failure =>
+          throw new Exception(s"FIRRTL failed on $config: $failure")
+      }
+    }
+  }
+}
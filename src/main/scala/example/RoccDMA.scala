@@ -0,0 +1,162 @@
+package example
+
+import chisel3._
+import chisel3.util._
+import freechips.rocketchip.config.Parameters
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.tile._
+import freechips.rocketchip.tilelink._
+
+// memcpy and memset engine.
+//
+// Data moves one beat at a time, with up to nXacts beats in flight: a copy
+// beat is a Get from the source followed by a PutFullData of the returned
+// data to the destination, and a fill beat is just the Put. Addresses and
+// lengths must be multiples of the beat size; tests/dma.h handles the
+// unaligned cases in software.
+//
+//   funct 0 (LEN):    rs1 = length in bytes of the next transfer
+//   funct 1 (MEMCPY): rs1 = destination, rs2 = source. Starts the copy.
+//   funct 2 (MEMSET): rs1 = destination, rs2 = 64-bit fill pattern.
+//                     Starts the fill.
+//   funct 3 (WAIT):   rd = 0 once the transfer has finished
+//
+// Commands are only accepted between transfers, and busy is held during
+// one, so WAIT or a fence on the core waits for the data to land.
+case class RoccDMAParams(nXacts: Int = 8)
+
+object RoccDMA {
+  val LEN = 0
+  val MEMCPY = 1
+  val MEMSET = 2
+  val WAIT = 3
+}
+
+class RoccDMA(
+    opcodes: OpcodeSet,
+    val params: RoccDMAParams = RoccDMAParams())
+    (implicit p: Parameters) extends LazyRoCC(opcodes) {
+  override lazy val module = new RoccDMAModuleImp(this)
+  override val atlNode = TLClientNode(Seq(TLClientPortParameters(Seq(
+    TLClientParameters(
+      name = "RoccDMA",
+      sourceId = IdRange(0, params.nXacts))))))
+}
+
+class RoccDMAModuleImp(outer: RoccDMA)(implicit p: Parameters)
+    extends LazyRoCCModuleImp(outer) with HasCoreParameters {
+  import RoccDMA._
+
+  val nXacts = outer.params.nXacts
+
+  val (tl_out, edge) = outer.atlNode.out(0)
+  val beatBytes = edge.manager.beatBytes
+  val lgBeatBytes = log2Ceil(beatBytes)
+  val dataBits = beatBytes * 8
+  require(dataBits % xLen == 0, "Fill pattern must divide the beat")
+
+  // Per-beat state: free, waiting on the Get, holding data for the Put,
+  // or waiting on the Put's ack
+  val x_free :: x_get :: x_put :: x_ack :: Nil = Enum(4)
+  val xState = RegInit(VecInit(Seq.fill(nXacts)(x_free)))
+  val xData = Reg(Vec(nXacts, UInt(dataBits.W)))
+  val xDst = Reg(Vec(nXacts, UInt(coreMaxAddrBits.W)))
+
+  val len = Reg(UInt(coreMaxAddrBits.W))
+  val dst = Reg(UInt(coreMaxAddrBits.W))
+  val src = Reg(UInt(coreMaxAddrBits.W))
+  val fill = Reg(UInt(dataBits.W))
+  val isFill = Reg(Bool())
+  val offset = Reg(UInt(coreMaxAddrBits.W))
+  val running = RegInit(false.B)
+
+  val respValid = RegInit(false.B)
+  val respRd = Reg(UInt(5.W))
+
+  val freeVec = xState.map(_ === x_free)
+  val putVec = xState.map(_ === x_put)
+  val freeId = PriorityEncoder(freeVec)
+  val putId = PriorityEncoder(putVec)
+  val canPut = putVec.reduce(_ || _)
+  val canStart = running && offset < len && freeVec.reduce(_ || _)
+
+  val getBits = edge.Get(
+    fromSource = freeId,
+    toAddress = src + offset,
+    lgSize = lgBeatBytes.U)._2
+  val putBits = edge.Put(
+    fromSource = putId,
+    toAddress = xDst(putId),
+    lgSize = lgBeatBytes.U,
+    data = xData(putId))._2
+  val fillBits = edge.Put(
+    fromSource = freeId,
+    toAddress = dst + offset,
+    lgSize = lgBeatBytes.U,
+    data = fill)._2
+
+  // Finishing a copy beat comes before starting a new one, so data does
+  // not pile up waiting for the A channel
+  tl_out.a.valid := canPut || canStart
+  tl_out.a.bits := Mux(canPut, putBits, Mux(isFill, fillBits, getBits))
+
+  when (tl_out.a.fire()) {
+    when (canPut) {
+      xState(putId) := x_ack
+    } .otherwise {
+      xState(freeId) := Mux(isFill, x_ack, x_get)
+      xDst(freeId) := dst + offset
+      offset := offset + beatBytes.U
+    }
+  }
+
+  tl_out.d.ready := true.B
+
+  when (tl_out.d.fire()) {
+    val id = tl_out.d.bits.source
+    when (xState(id) === x_get) {
+      xState(id) := x_put
+      xData(id) := tl_out.d.bits.data
+    } .otherwise {
+      xState(id) := x_free
+    }
+  }
+
+  when (running && offset >= len && freeVec.reduce(_ && _)) {
+    running := false.B
+  }
+
+  val cmd = io.cmd
+  val funct = cmd.bits.inst.funct
+  cmd.ready := !running && !respValid
+
+  when (cmd.fire()) {
+    when (funct === LEN.U) {
+      len := cmd.bits.rs1
+    }
+    when (funct === MEMCPY.U || funct === MEMSET.U) {
+      dst := cmd.bits.rs1
+      src := cmd.bits.rs2
+      fill := Fill(dataBits / xLen, cmd.bits.rs2)
+      isFill := funct === MEMSET.U
+      offset := 0.U
+      running := len =/= 0.U
+    }
+    respRd := cmd.bits.inst.rd
+    respValid := cmd.bits.inst.xd
+  }
+
+  io.resp.valid := respValid
+  io.resp.bits.rd := respRd
+  io.resp.bits.data := 0.U
+
+  when (io.resp.fire()) { respValid := false.B }
+
+  io.busy := running || respValid
+  io.interrupt := false.B
+  io.mem.req.valid := false.B
+  // Tie off unused channels
+  tl_out.b.ready := true.B
+  tl_out.c.valid := false.B
+  tl_out.e.valid := false.B
+}
@@ -0,0 +1,175 @@
+package example
+
+import chisel3._
+import chisel3.util._
+import freechips.rocketchip.config.Parameters
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.subsystem.CacheBlockBytes
+import freechips.rocketchip.tile._
+import freechips.rocketchip.tilelink._
+
+// Character counting over an arbitrary-length buffer, for any of up to
+// eight needles at once.
+//
+// Unlike the CharacterCountExample in rocket-chip, which fetches one block
+// at a time and stops at a NUL, this keeps up to nXacts block reads in
+// flight and counts every byte of [addr, addr + len) as the beats arrive.
+// Starting a scan does not write a register, so the core can go on with
+// other work and pick the counts up later.
+//
+//   funct 0 (SET_NEEDLES): rs1 = needle bytes, packed from the low byte,
+//                          rs2 = number of needles
+//   funct 1 (START):       rs1 = buffer address, rs2 = length in bytes
+//   funct 2 (RESULT):      rd = count for needle rs1, or the total over
+//                          all needles if rs1 >= nNeedles. Waits for the
+//                          scan to finish.
+//   funct 3 (POLL):        rd = 1 if no scan is running, else 0
+//
+// busy is held while a scan runs, so a fence waits for it to finish.
+case class StreamingCharCountParams(
+  nNeedles: Int = 8,
+  nXacts: Int = 4)
+
+object StreamingCharCount {
+  val SET_NEEDLES = 0
+  val START = 1
+  val RESULT = 2
+  val POLL = 3
+}
+
+class StreamingCharCount(
+    opcodes: OpcodeSet,
+    val params: StreamingCharCountParams = StreamingCharCountParams())
+    (implicit p: Parameters) extends LazyRoCC(opcodes) {
+  override lazy val module = new StreamingCharCountModuleImp(this)
+  override val atlNode = TLClientNode(Seq(TLClientPortParameters(Seq(
+    TLClientParameters(
+      name = "StreamingCharCountRoCC",
+      sourceId = IdRange(0, params.nXacts))))))
+}
+
+class StreamingCharCountModuleImp(outer: StreamingCharCount)
+    (implicit p: Parameters) extends LazyRoCCModuleImp(outer)
+    with HasCoreParameters {
+  import StreamingCharCount._
+
+  val nNeedles = outer.params.nNeedles
+  val nXacts = outer.params.nXacts
+  require(nNeedles <= xLen / 8, "Needles must fit in one register")
+
+  val (tl_out, edge) = outer.atlNode.out(0)
+  val blockBytes = p(CacheBlockBytes)
+  val beatBytes = edge.manager.beatBytes
+  val lgBlockBytes = log2Ceil(blockBytes)
+  val lgBeatBytes = log2Ceil(beatBytes)
+
+  val needles = Reg(Vec(nNeedles, UInt(8.W)))
+  val nActive = Reg(UInt(log2Ceil(nNeedles + 1).W))
+  val counts = Reg(Vec(nNeedles, UInt(xLen.W)))
+
+  val start = Reg(UInt(coreMaxAddrBits.W))
+  val end = Reg(UInt(coreMaxAddrBits.W))
+  val nextBlock = Reg(UInt(coreMaxAddrBits.W))
+  val xactBlock = Reg(Vec(nXacts, UInt(coreMaxAddrBits.W)))
+  val xactBusy = RegInit(0.U(nXacts.W))
+  val running = RegInit(false.B)
+
+  val respValid = RegInit(false.B)
+  val respRd = Reg(UInt(5.W))
+  val respData = Reg(UInt(xLen.W))
+
+  // Read whole blocks, as many at once as there are free source IDs
+  val xactFree = ~xactBusy
+  val xactId = PriorityEncoder(xactFree)
+  val issueDone = nextBlock >= end
+
+  tl_out.a.valid := running && !issueDone && xactFree.orR
+  tl_out.a.bits := edge.Get(
+    fromSource = xactId,
+    toAddress = nextBlock,
+    lgSize = lgBlockBytes.U)._2
+
+  when (tl_out.a.fire()) {
+    xactBlock(xactId) := nextBlock
+    nextBlock := nextBlock + blockBytes.U
+  }
+
+  // Count each beat as it arrives. Only the first and last blocks can
+  // hold bytes outside the buffer.
+  val (_, dLast, _, dBeat) = edge.count(tl_out.d)
+  val beatAddr = xactBlock(tl_out.d.bits.source) + (dBeat << lgBeatBytes)
+  val dataBytes = Seq.tabulate(beatBytes) { i =>
+    tl_out.d.bits.data(8 * i + 7, 8 * i)
+  }
+  val inRange = Seq.tabulate(beatBytes) { i =>
+    val addr = beatAddr + i.U
+    addr >= start && addr < end
+  }
+
+  tl_out.d.ready := true.B
+
+  when (tl_out.d.fire()) {
+    for (k <- 0 until nNeedles) {
+      val matches = dataBytes.zip(inRange).map {
+        case (byte, valid) => valid && byte === needles(k)
+      }
+      when (k.U < nActive) {
+        counts(k) := counts(k) + PopCount(matches)
+      }
+    }
+  }
+
+  val xactAlloc = Mux(tl_out.a.fire(), UIntToOH(xactId, nXacts), 0.U)
+  val xactDone = Mux(tl_out.d.fire() && dLast,
+    UIntToOH(tl_out.d.bits.source, nXacts), 0.U)
+  xactBusy := (xactBusy | xactAlloc) & ~xactDone
+
+  when (running && issueDone && xactBusy === 0.U) {
+    running := false.B
+  }
+
+  // Only POLL is accepted while a scan is running. Any other command holds
+  // the core until the scan is done, so read the result as late as possible.
+  val cmd = io.cmd
+  val funct = cmd.bits.inst.funct
+  cmd.ready := !respValid && (funct === POLL.U || !running)
+
+  when (cmd.fire()) {
+    when (funct === SET_NEEDLES.U) {
+      for (k <- 0 until nNeedles) {
+        needles(k) := cmd.bits.rs1(8 * k + 7, 8 * k)
+      }
+      nActive := Mux(cmd.bits.rs2 > nNeedles.U, nNeedles.U, cmd.bits.rs2)
+    }
+    when (funct === START.U) {
+      start := cmd.bits.rs1
+      end := cmd.bits.rs1 + cmd.bits.rs2
+      nextBlock := cmd.bits.rs1 >> lgBlockBytes << lgBlockBytes
+      counts.foreach(_ := 0.U)
+      running := cmd.bits.rs2 =/= 0.U
+    }
+    when (funct === RESULT.U) {
+      respData := MuxLookup(cmd.bits.rs1, counts.reduce(_ + _),
+        counts.zipWithIndex.map { case (count, k) => k.U -> count })
+    }
+    when (funct === POLL.U) {
+      respData := !running
+    }
+    respRd := cmd.bits.inst.rd
+    respValid := cmd.bits.inst.xd
+  }
+
+  io.resp.valid := respValid
+  io.resp.bits.rd := respRd
+  io.resp.bits.data := respData
+
+  when (io.resp.fire()) { respValid := false.B }
+
+  io.busy := running || respValid
+  io.interrupt := false.B
+  io.mem.req.valid := false.B
+  // Tie off unused channels
+  tl_out.b.ready := true.B
+  tl_out.c.valid := false.B
+  tl_out.e.valid := false.B
+}
@@ -10,6 +10,8 @@ case object BuildTop extends Field[(Clock, Bool, Parameters) => ExampleTopModule
 class TestHarness(implicit val p: Parameters) extends Module {
   val io = IO(new Bundle {
     val success = Output(Bool())
+    val trace = Output(new TraceTap)
+    val traffic = Output(new TrafficTaps)
   })
 
   val dut = p(BuildTop)(clock, reset.toBool, p)
@@ -18,6 +20,8 @@ class TestHarness(implicit val p: Parameters) extends Module {
   dut.dontTouchPorts()
   dut.tieOffInterrupts()
   io.success := dut.connectSimSerial()
+  io.trace := dut.traceTap
+  io.traffic := dut.trafficTaps
 }
 
 object Generator extends GeneratorApp {
@@ -25,6 +25,8 @@ class ExampleTopModuleImp[+L <: ExampleTop](l: L) extends RocketSubsystemModuleI
     with HasExtInterruptsModuleImp
     with HasNoDebugModuleImp
     with HasPeripherySerialModuleImp
+    with HasTraceTapModuleImp
+    with HasTrafficTapsModuleImp
     with DontTouch
 
 class ExampleTopWithPWM(implicit p: Parameters) extends ExampleTop
@@ -43,6 +45,7 @@ class ExampleTopWithBlockDevice(implicit p: Parameters) extends ExampleTop
 class ExampleTopWithBlockDeviceModule(l: ExampleTopWithBlockDevice)
   extends ExampleTopModuleImp(l)
   with HasPeripheryBlockDeviceModuleImp
+  with HasBlockDeviceTrafficTap
 
 class ExampleTopWithIceNIC(implicit p: Parameters) extends ExampleTop
     with HasPeripheryIceNIC {
@@ -52,3 +55,19 @@ class ExampleTopWithIceNIC(implicit p: Parameters) extends ExampleTop
 class ExampleTopWithIceNICModule(outer: ExampleTopWithIceNIC)
   extends ExampleTopModuleImp(outer)
   with HasPeripheryIceNICModuleImp
+  with HasIceNICTrafficTap
+
+class ExampleTopWithMMIODevices(implicit p: Parameters) extends ExampleTop
+    with HasPeripheryPWM
+    with HasPeripheryBlockDevice
+    with HasPeripheryIceNIC {
+  override lazy val module = new ExampleTopWithMMIODevicesModule(this)
+}
+
+class ExampleTopWithMMIODevicesModule(outer: ExampleTopWithMMIODevices)
+  extends ExampleTopModuleImp(outer)
+  with HasPeripheryPWMModuleImp
+  with HasPeripheryBlockDeviceModuleImp
+  with HasPeripheryIceNICModuleImp
+  with HasBlockDeviceTrafficTap
+  with HasIceNICTrafficTap
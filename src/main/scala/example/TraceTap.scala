@@ -0,0 +1,75 @@
+package example
+
+import chisel3._
+import chisel3.util.experimental.BoringUtils
+import freechips.rocketchip.diplomacy.LazyModuleImp
+import freechips.rocketchip.subsystem.HasRocketTiles
+
+// What hart 0's decode slot did in a cycle, for the +topdown breakdown in
+// verisim/csrc/topdown.h, which has the same encoding
+object TopDown {
+  val unknown = 0
+  val retiring = 1
+  val frontend = 2
+  val badSpeculation = 3
+  val backendMemory = 4
+  val backendCore = 5
+  val width = 3
+}
+
+// Retired instruction of hart 0, brought out to the test harness for
+// profiling (see +pc-sample in verisim/csrc/pc-sampler.h), and what its
+// pipeline did that cycle
+class TraceTap extends Bundle {
+  val valid = Bool()
+  val pc = UInt(64.W)
+  val insn = UInt(32.W)
+  val slot = UInt(TopDown.width.W)
+}
+
+// The core's trace port and stall signals are not exposed by the tile, so
+// they are bored out of the core directly
+trait HasTraceTapModuleImp extends LazyModuleImp {
+  val outer: HasRocketTiles
+
+  val traceTap = IO(Output(new TraceTap))
+
+  private val core = outer.rocketTiles.head.module.core
+
+  private def tap[T <: Data](source: T): T = {
+    val sink = Wire(chiselTypeOf(source))
+    sink := 0.U.asTypeOf(sink)
+    BoringUtils.bore(source, Seq(sink))
+    sink
+  }
+
+  private val trace = core.io.trace(0)
+  traceTap.valid := tap(trace.valid)
+  traceTap.pc := tap(trace.iaddr)
+  traceTap.insn := tap(trace.insn)
+
+  // Cycles are accounted at decode, the way Rocket's own interlock
+  // counters do: a cycle is a flush if the pipeline is being redirected,
+  // a frontend bubble if there is nothing to decode, a stall if decode is
+  // held up, and retiring if it issues.
+  private val flush = tap(core.take_pc_mem_wb)
+  private val fetched = tap(core.ibuf.io.inst(0).valid) &&
+    !tap(core.ibuf.io.inst(0).bits.replay)
+  private val stalled = tap(core.ctrl_stalld)
+
+  // Stalls on loads and stores: a use of a load that has not come back,
+  // the D$ being busy, or a fence waiting for memory. Long-latency
+  // writebacks also include divides, but those are rare next to misses.
+  private val loadUse =
+    tap(core.id_ex_hazard) && tap(core.ex_ctrl.mem) ||
+    tap(core.id_mem_hazard) && tap(core.mem_ctrl.mem) ||
+    tap(core.id_wb_hazard) && tap(core.wb_ctrl.mem)
+  private val memoryStall = loadUse || tap(core.id_sboard_hazard) ||
+    tap(core.id_ctrl.mem) && tap(core.dcache_blocked) ||
+    tap(core.id_do_fence)
+
+  traceTap.slot := Mux(flush, TopDown.badSpeculation.U,
+    Mux(!fetched, TopDown.frontend.U,
+    Mux(stalled, Mux(memoryStall, TopDown.backendMemory.U, TopDown.backendCore.U),
+    TopDown.retiring.U)))
+}
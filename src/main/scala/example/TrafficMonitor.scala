@@ -0,0 +1,182 @@
+package example
+
+import chisel3._
+import chisel3.util._
+import chisel3.util.experimental.BoringUtils
+import freechips.rocketchip.amba.axi4.AXI4Bundle
+import freechips.rocketchip.diplomacy.LazyModuleImp
+import freechips.rocketchip.subsystem.{CanHaveMasterAXI4MemPortModuleImp, HasRocketTiles}
+import freechips.rocketchip.tilelink._
+import testchipip.{HasPeripheryBlockDevice, HasPeripheryBlockDeviceModuleImp}
+import icenet.{HasPeripheryIceNIC, HasPeripheryIceNICModuleImp}
+
+// First beat of a read or write request on a monitored port
+class TrafficReq extends Bundle {
+  val write = Bool()
+  val id = UInt(16.W)
+  val addr = UInt(64.W)
+  val bytes = UInt(16.W)
+}
+
+// Last beat of the response that completes a request
+class TrafficResp extends Bundle {
+  val write = Bool()
+  val id = UInt(16.W)
+}
+
+// Handshakes of one port, for the traffic monitors in
+// verisim/csrc/traffic-monitor.h. A port can start two requests and finish
+// two in a cycle (TileLink A and C, or AXI4 AR and AW; AXI4 R and B).
+// Requests and responses are matched by direction and id, so latency is
+// from the first beat of a request to the last beat of its response.
+class TrafficTap extends Bundle {
+  val req = Vec(2, Valid(new TrafficReq))
+  val resp = Vec(2, Valid(new TrafficResp))
+}
+
+// Device events, one cycle each, for the +stats-socket counters
+class DeviceEvents extends Bundle {
+  val nicSend = Bool()        // last flit of a packet sent by the NIC
+  val nicRecv = Bool()        // last flit of a packet sent to the NIC
+  val blkdevRequest = Bool()  // request accepted by the block device model
+}
+
+class TrafficTaps extends Bundle {
+  val mem = new TrafficTap     // AXI4 memory port
+  val core = new TrafficTap    // hart 0's TileLink master port
+  val blkdev = new TrafficTap  // block device DMA on the front bus
+  val icenic = new TrafficTap  // IceNIC DMA on the front bus
+  val events = new DeviceEvents
+}
+
+object TrafficTap {
+  def tieOff(tap: TrafficTap) {
+    tap.req.foreach(_.valid := false.B)
+    tap.resp.foreach(_.valid := false.B)
+    tap.req.foreach(_.bits := DontCare)
+    tap.resp.foreach(_.bits := DontCare)
+  }
+
+  private def req(valid: Bool, write: Bool, id: UInt, addr: UInt, bytes: UInt) = {
+    val r = Wire(Valid(new TrafficReq))
+    r.valid := valid
+    r.bits.write := write
+    r.bits.id := id
+    r.bits.addr := addr
+    r.bits.bytes := bytes
+    r
+  }
+
+  private def resp(valid: Bool, write: Bool, id: UInt) = {
+    val r = Wire(Valid(new TrafficResp))
+    r.valid := valid
+    r.bits.write := write
+    r.bits.id := id
+    r
+  }
+
+  // The AXI4 memory port is on the top-level IO, so it can be watched
+  // directly
+  def apply(axi: AXI4Bundle): TrafficTap = {
+    val tap = Wire(new TrafficTap)
+    def bytes(len: UInt, size: UInt) = (len +& 1.U) << size
+    tap.req(0) := req(axi.ar.fire(), false.B, axi.ar.bits.id,
+      axi.ar.bits.addr, bytes(axi.ar.bits.len, axi.ar.bits.size))
+    tap.req(1) := req(axi.aw.fire(), true.B, axi.aw.bits.id,
+      axi.aw.bits.addr, bytes(axi.aw.bits.len, axi.aw.bits.size))
+    tap.resp(0) := resp(axi.r.fire() && axi.r.bits.last, false.B, axi.r.bits.id)
+    tap.resp(1) := resp(axi.b.fire(), true.B, axi.b.bits.id)
+    tap
+  }
+
+  // TileLink links inside the subsystem are not visible from the module
+  // doing the monitoring, so the signals are bored out of the link
+  def apply(link: (TLBundle, TLEdgeOut)): TrafficTap = {
+    val (bundle, edge) = link
+
+    def bore[T <: Data](source: T): T = {
+      val sink = Wire(chiselTypeOf(source))
+      sink := 0.U.asTypeOf(sink)
+      BoringUtils.bore(source, Seq(sink))
+      sink
+    }
+
+    def channel[T <: TLChannel](source: DecoupledIO[T],
+        fields: (T, T) => Unit): DecoupledIO[T] = {
+      val sink = Wire(chiselTypeOf(source))
+      sink := DontCare
+      sink.valid := bore(source.valid)
+      sink.ready := bore(source.ready)
+      fields(sink.bits, source.bits)
+      sink
+    }
+
+    val a = channel[TLBundleA](bundle.a, (s, x) => {
+      s.opcode := bore(x.opcode)
+      s.size := bore(x.size)
+      s.source := bore(x.source)
+      s.address := bore(x.address)
+    })
+    val d = channel[TLBundleD](bundle.d, (s, x) => {
+      s.opcode := bore(x.opcode)
+      s.size := bore(x.size)
+      s.source := bore(x.source)
+    })
+
+    val tap = Wire(new TrafficTap)
+    val aWrite = a.bits.opcode === TLMessages.PutFullData ||
+      a.bits.opcode === TLMessages.PutPartialData
+    val dWrite = d.bits.opcode === TLMessages.AccessAck ||
+      d.bits.opcode === TLMessages.ReleaseAck
+    tap.req(0) := req(a.fire() && edge.first(a), aWrite, a.bits.source,
+      a.bits.address, UIntToOH(a.bits.size))
+    tap.resp(0) := resp(d.fire() && edge.last(d), dWrite, d.bits.source)
+
+    // Dirty lines written back by a cached master
+    if (edge.client.anySupportProbe && edge.manager.anySupportAcquireB) {
+      val c = channel[TLBundleC](bundle.c, (s, x) => {
+        s.opcode := bore(x.opcode)
+        s.size := bore(x.size)
+        s.source := bore(x.source)
+        s.address := bore(x.address)
+      })
+      tap.req(1) := req(c.fire() && edge.first(c) &&
+        c.bits.opcode === TLMessages.ReleaseData, true.B, c.bits.source,
+        c.bits.address, UIntToOH(c.bits.size))
+    } else {
+      tap.req(1) := req(false.B, true.B, 0.U, 0.U, 0.U)
+    }
+    tap.resp(1) := resp(false.B, false.B, 0.U)
+    tap
+  }
+}
+
+trait HasTrafficTapsModuleImp extends LazyModuleImp {
+  this: CanHaveMasterAXI4MemPortModuleImp =>
+  val outer: HasRocketTiles
+
+  val trafficTaps = IO(Output(new TrafficTaps))
+
+  trafficTaps.mem := TrafficTap(mem_axi4.head)
+  TrafficTap.tieOff(trafficTaps.blkdev)
+  TrafficTap.tieOff(trafficTaps.icenic)
+  trafficTaps.events := 0.U.asTypeOf(new DeviceEvents)
+  trafficTaps.core := TrafficTap(outer.rocketTiles.head.masterNode.out.head)
+}
+
+trait HasBlockDeviceTrafficTap extends HasTrafficTapsModuleImp {
+  this: CanHaveMasterAXI4MemPortModuleImp with HasPeripheryBlockDeviceModuleImp =>
+  val outer: HasRocketTiles with HasPeripheryBlockDevice
+
+  trafficTaps.blkdev := TrafficTap(outer.controller.mem.out.head)
+  trafficTaps.events.blkdevRequest := bdev.req.fire()
+}
+
+trait HasIceNICTrafficTap extends HasTrafficTapsModuleImp {
+  this: CanHaveMasterAXI4MemPortModuleImp with HasPeripheryIceNICModuleImp =>
+  val outer: HasRocketTiles with HasPeripheryIceNIC
+
+  trafficTaps.icenic := TrafficTap(outer.icenic.dmanode.out.head)
+  trafficTaps.events.nicSend := net.out.fire() && net.out.bits.last
+  trafficTaps.events.nicRecv := net.in.fire() && net.in.bits.last
+}
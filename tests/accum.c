@@ -1,27 +1,4 @@
-#include "rocc.h"
-
-static inline void accum_write(int idx, unsigned long data)
-{
-	ROCC_INSTRUCTION_SS(0, data, idx, 0);
-}
-
-static inline unsigned long accum_read(int idx)
-{
-	unsigned long value;
-	ROCC_INSTRUCTION_DSS(0, value, 0, idx, 1);
-	return value;
-}
-
-static inline void accum_load(int idx, void *ptr)
-{
-	asm volatile ("fence");
-	ROCC_INSTRUCTION_SS(0, (uintptr_t) ptr, idx, 2);
-}
-
-static inline void accum_add(int idx, unsigned long addend)
-{
-	ROCC_INSTRUCTION_SS(0, addend, idx, 3);
-}
+#include "accum.h"
 
 unsigned long data = 0x3421L;
 
@@ -0,0 +1,75 @@
+#ifndef __ACCUM_H__
+#define __ACCUM_H__
+
+// Wrappers for the rocket-chip AccumulatorExample RoCC on custom0
+// (RoccExampleConfig), and the programming model the RoCC tests follow.
+//
+// A command with no destination register (xd=0) is posted: the core hands
+// it to the accelerator and carries on, stalling only if the command queue
+// is full. A command with a destination register (xd=1) is a round trip;
+// the core stalls when it uses rd until the accelerator responds.
+//
+// The accumulator executes commands one at a time in the order they were
+// issued. So a batch of posted commands can be closed with any xd=1
+// command, and its response means the whole batch has finished. That
+// response is the doorbell. No fence is needed around any of this:
+//   - Commands are ordered with each other by the core.
+//   - The accumulator's loads go through the core's own L1 data cache,
+//     behind the stores that came before them.
+// A fence is only needed to wait for an accelerator to go idle, for
+// instance before the core reads memory the accelerator has written.
+//
+// Accelerators that read memory over TileLink (CharacterCountExample,
+// StreamingCharCount, RoccDMA) do not go through the L1, so their wrappers
+// keep a fence in front of commands that read memory.
+
+#include <stdint.h>
+
+#include "rocc.h"
+
+#define ACCUM_NREGS 4
+
+static inline void accum_write(int idx, unsigned long data)
+{
+	ROCC_INSTRUCTION_SS(0, data, idx, 0);
+}
+
+static inline unsigned long accum_read(int idx)
+{
+	unsigned long value;
+	ROCC_INSTRUCTION_DSS(0, value, 0, idx, 1);
+	return value;
+}
+
+static inline void accum_load(int idx, void *ptr)
+{
+	ROCC_INSTRUCTION_SS(0, (uintptr_t) ptr, idx, 2);
+}
+
+static inline void accum_add(int idx, unsigned long addend)
+{
+	ROCC_INSTRUCTION_SS(0, addend, idx, 3);
+}
+
+// Blocking add: returns the register's value from before the add
+static inline unsigned long accum_add_sync(int idx, unsigned long addend)
+{
+	unsigned long old;
+	ROCC_INSTRUCTION_DSS(0, old, addend, idx, 3);
+	return old;
+}
+
+// Completion counter. Posting accum_complete() after each batch counts
+// the batches in an accumulator register; accum_doorbell() waits for
+// everything posted so far and returns how many batches have completed.
+static inline void accum_complete(int counter)
+{
+	accum_add(counter, 1);
+}
+
+static inline unsigned long accum_doorbell(int counter)
+{
+	return accum_read(counter);
+}
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "encoding.h"
+#include "mt.h"
+
+// Throughput of atomic operations under contention, with 1 to NCORES harts.
+//
+//   amoadd:   amoadd.d of 1 to a counter
+//   amoswap:  amoswap.d of the hart id into a word
+//   lrsc:     increment done as an lr.d/sc.d retry loop
+//   cas-lock: test-and-test-and-set lock taken with compare-and-swap,
+//             guarding a plain increment
+//
+// With the "shared" layout every hart works on the same cache line, so the
+// line bounces between L1s; with "padded" each hart has its own line and
+// only pays for the atomic itself.
+//
+// Build as atomics-bench-<n>c.riscv (make NCORES=n) for an n-core config,
+// e.g. DualCoreConfig or QuadCoreConfig.
+//
+// Results are CSV rows prefixed with "atomics", the first of which holds
+// the column names. Throughput is in operations per kilocycle per hart.
+
+#define NOPS 1024
+
+struct slot {
+	volatile long lock;
+	volatile long value;
+} __attribute__((aligned(64)));
+
+static struct slot slots[NCORES];
+
+enum test { AMOADD, AMOSWAP, LRSC, CAS_LOCK, NTESTS };
+enum layout { SHARED, PADDED, NLAYOUTS };
+
+static const char *test_names[] = { "amoadd", "amoswap", "lrsc", "cas-lock" };
+static const char *layout_names[] = { "shared", "padded" };
+
+static volatile int cur_test, cur_layout, cur_threads;
+
+static inline void amoadd(volatile long *p)
+{
+	asm volatile ("amoadd.d zero, %1, %0" : "+A" (*p) : "r" (1L));
+}
+
+static inline long amoswap(volatile long *p, long v)
+{
+	long old;
+
+	asm volatile ("amoswap.d %0, %2, %1" : "=r" (old), "+A" (*p) : "r" (v));
+	return old;
+}
+
+static inline void lrsc_inc(volatile long *p)
+{
+	long tmp, fail;
+
+	asm volatile (
+		"1: lr.d %0, %2\n"
+		"   addi %0, %0, 1\n"
+		"   sc.d %1, %0, %2\n"
+		"   bnez %1, 1b\n"
+		: "=&r" (tmp), "=&r" (fail), "+A" (*p));
+}
+
+static inline void lock_acquire(volatile long *lock)
+{
+	do {
+		while (*lock)
+			;
+	} while (!__sync_bool_compare_and_swap(lock, 0, 1));
+}
+
+static inline void lock_release(volatile long *lock)
+{
+	__sync_lock_release(lock);
+}
+
+static void run_ops(int cid, enum test test, enum layout layout)
+{
+	struct slot *s = &slots[layout == SHARED ? 0 : cid];
+	int i;
+
+	for (i = 0; i < NOPS; i++) {
+		switch (test) {
+		case AMOADD:
+			amoadd(&s->value);
+			break;
+		case AMOSWAP:
+			amoswap(&s->value, cid);
+			break;
+		case LRSC:
+			lrsc_inc(&s->value);
+			break;
+		case CAS_LOCK:
+			lock_acquire(&s->lock);
+			s->value = s->value + 1;
+			lock_release(&s->lock);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void thread_entry(int cid, int nc)
+{
+	if (cid == 0)
+		return;
+
+	for (;;) {
+		mt_barrier(nc);
+		if (cid < cur_threads)
+			run_ops(cid, cur_test, cur_layout);
+		mt_barrier(nc);
+	}
+}
+
+static void check(enum test test, enum layout layout, int threads)
+{
+	long expected;
+	int i;
+
+	if (test == AMOSWAP)
+		return;
+
+	for (i = 0; i < (layout == SHARED ? 1 : threads); i++) {
+		expected = (layout == SHARED) ? (long) NOPS * threads : NOPS;
+		if (slots[i].value != expected) {
+			printf("%s %s with %d threads: slot %d holds %ld, "
+				"expected %ld\n", test_names[test],
+				layout_names[layout], threads, i,
+				slots[i].value, expected);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void run_test(enum test test, enum layout layout, int threads)
+{
+	unsigned long start, cycles;
+	int i;
+
+	for (i = 0; i < NCORES; i++) {
+		slots[i].lock = 0;
+		slots[i].value = 0;
+	}
+
+	cur_test = test;
+	cur_layout = layout;
+	cur_threads = threads;
+
+	mt_barrier(NCORES);
+	start = rdcycle();
+	run_ops(0, test, layout);
+	mt_barrier(NCORES);
+	cycles = rdcycle() - start;
+
+	check(test, layout, threads);
+
+	printf("atomics,%s,%s,%d,%d,%lu,%lu\n",
+		test_names[test], layout_names[layout], threads, NOPS,
+		cycles, (unsigned long) NOPS * 1000 / cycles);
+}
+
+int main(void)
+{
+	int test, layout, threads;
+
+	printf("atomics,test,layout,threads,ops_per_thread,cycles,"
+		"ops_per_kcycle_per_thread\n");
+
+	for (test = 0; test < NTESTS; test++) {
+		for (layout = 0; layout < NLAYOUTS; layout++) {
+			for (threads = 1; threads <= NCORES; threads++)
+				run_test(test, layout, threads);
+		}
+	}
+
+	return 0;
+}
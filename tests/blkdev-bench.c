@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mmio.h"
+#include "blkdev.h"
+#include "encoding.h"
+
+// fio-style block device benchmark.
+//
+// Sequential and random reads and writes are run for each request size
+// (in sectors, up to blkdev_max_req_len()) and queue depth (up to the
+// number of request slots the controller has free at startup). Each test
+// keeps "depth" requests outstanding until NREQS have completed.
+//
+// Results are CSV rows prefixed with "blkdev-bench", the first of which
+// holds the column names. Bandwidth is in bytes per kilocycle and IOPS in
+// requests per megacycle, so results compare across clock rates.
+//
+// The benchmark writes over the disk, so give it a scratch image.
+
+#define NREQS 64
+#define BUF_SECTORS 128
+// Random offsets are drawn from the first SPAN_SECTORS of the disk
+#define SPAN_SECTORS 4096
+#define MAX_TAGS 256
+
+#define SECTOR_WORDS (BLKDEV_SECTOR_SIZE / sizeof(uint64_t))
+
+enum pattern { SEQ_READ, SEQ_WRITE, RAND_READ, RAND_WRITE, NPATTERNS };
+
+static const char *pattern_names[] = {
+	"seqread", "seqwrite", "randread", "randwrite"
+};
+
+uint64_t buffer[BUF_SECTORS][SECTOR_WORDS];
+unsigned long submit_cycle[MAX_TAGS];
+// Requests can complete out of order, so the buffer slices in use are
+// tracked by tag, and a new request takes one that is free
+int tag_slot[MAX_TAGS];
+int free_slots[MAX_TAGS];
+
+static unsigned long rand_state = 0x2545f4914f6cdd1dUL;
+
+static unsigned long next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+static void run_test(enum pattern pattern, unsigned int span,
+		unsigned int reqlen, int depth)
+{
+	int write = (pattern == SEQ_WRITE || pattern == RAND_WRITE);
+	int random = (pattern == RAND_READ || pattern == RAND_WRITE);
+	int sent = 0, done = 0, nfree = depth, i;
+	unsigned int offset = 0;
+	unsigned long start, cycles, total_latency = 0;
+
+	for (i = 0; i < depth; i++)
+		free_slots[i] = i;
+
+	start = rdcycle();
+
+	while (done < NREQS) {
+		int n = reg_read8(BLKDEV_NCOMPLETE);
+
+		for (i = 0; i < n; i++) {
+			int tag = reg_read8(BLKDEV_COMPLETE);
+			total_latency += rdcycle() - submit_cycle[tag];
+			free_slots[nfree++] = tag_slot[tag];
+		}
+		done += n;
+
+		while (sent - done < depth && sent < NREQS &&
+				reg_read8(BLKDEV_NREQUEST) > 0) {
+			// Each outstanding request gets its own slice of the
+			// buffer so concurrent reads do not write the same memory
+			int slot = free_slots[--nfree];
+			void *addr = buffer[slot * reqlen];
+			unsigned long now;
+			int tag;
+
+			if (random)
+				offset = (next_rand() % (span / reqlen)) * reqlen;
+			else if (offset + reqlen > span)
+				offset = 0;
+
+			now = rdcycle();
+			tag = blkdev_send_request(
+				(unsigned long) addr, offset, reqlen, write);
+			submit_cycle[tag] = now;
+			tag_slot[tag] = slot;
+
+			if (!random)
+				offset += reqlen;
+			sent++;
+		}
+	}
+
+	cycles = rdcycle() - start;
+
+	printf("blkdev-bench,%s,%u,%d,%d,%lu,%lu,%lu,%lu\n",
+		pattern_names[pattern], reqlen, depth, NREQS, cycles,
+		((unsigned long) NREQS * reqlen << BLKDEV_SECTOR_SHIFT) * 1000 / cycles,
+		(unsigned long) NREQS * 1000000 / cycles,
+		total_latency / NREQS);
+}
+
+int main(void)
+{
+	unsigned int nsectors = blkdev_nsectors();
+	unsigned int max_req_len = blkdev_max_req_len();
+	int max_depth = reg_read8(BLKDEV_NREQUEST);
+	unsigned int span, reqlen;
+	int pattern, depth, i, j;
+
+	span = nsectors < SPAN_SECTORS ? nsectors : SPAN_SECTORS;
+
+	for (i = 0; i < BUF_SECTORS; i++) {
+		for (j = 0; j < SECTOR_WORDS; j++)
+			buffer[i][j] = ((uint64_t) i << 32) | j;
+	}
+
+	asm volatile ("fence");
+
+	printf("blkdev-info,nsectors,max_req_len,nrequest\n");
+	printf("blkdev-info,%u,%u,%d\n", nsectors, max_req_len, max_depth);
+
+	printf("blkdev-bench,pattern,sectors,depth,requests,cycles,"
+		"bytes_per_kcycle,iops_per_mcycle,avg_latency\n");
+
+	for (pattern = 0; pattern < NPATTERNS; pattern++) {
+		for (reqlen = 1; reqlen <= max_req_len && reqlen <= span;
+				reqlen <<= 1) {
+			for (depth = 1; depth <= max_depth; depth <<= 1) {
+				if (reqlen * depth > BUF_SECTORS)
+					break;
+				run_test(pattern, span, reqlen, depth);
+			}
+		}
+	}
+
+	return 0;
+}
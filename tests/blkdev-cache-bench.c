@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mmio.h"
+#include "blkdev-cache.h"
+#include "encoding.h"
+
+// Runs a scan-and-reread workload over the block device twice, once going
+// straight to the driver and once through blkdev-cache.h, and reports the
+// cycles each phase took and the cache's hit rate.
+//
+// scan:   sequential 4-sector reads over the first SCAN_SECTORS
+// reread: random single-sector reads of a HOT_SECTORS hot set
+// update: random single-sector writes to the hot set, then a flush
+//
+// Results are CSV rows prefixed with "bcache-bench", the first of which
+// holds the column names. The update phase writes to the disk.
+
+#define SCAN_SECTORS 512
+#define SCAN_CHUNK 4
+#define HOT_SECTORS 32
+#define HOT_ACCESSES 256
+
+struct blkdev_driver blkdrv;
+struct bcache cache;
+
+uint64_t buf[SCAN_CHUNK][BCACHE_SECTOR_WORDS];
+uint64_t check_buf[BCACHE_SECTOR_WORDS];
+
+enum phase { SCAN, REREAD, UPDATE, NPHASES };
+
+static const char *phase_names[] = { "scan", "reread", "update" };
+
+static unsigned long rand_state;
+
+static unsigned int next_rand(void)
+{
+	rand_state = rand_state * 6364136223846793005UL + 1442695040888963407UL;
+	return rand_state >> 33;
+}
+
+static void fill_sector(uint64_t *data, unsigned int sector, int round)
+{
+	for (int i = 0; i < BCACHE_SECTOR_WORDS; i++)
+		data[i] = ((uint64_t) round << 48) | ((uint64_t) sector << 16) | i;
+}
+
+// Returns the number of accesses made
+static int run_phase(enum phase phase, unsigned int span, int cached)
+{
+	unsigned int sector;
+	int i;
+
+	rand_state = 1;
+
+	switch (phase) {
+	case SCAN:
+		for (sector = 0; sector + SCAN_CHUNK <= span; sector += SCAN_CHUNK) {
+			if (cached)
+				bcache_read(&cache, buf, sector, SCAN_CHUNK);
+			else
+				blkdev_driver_read(&blkdrv, buf, sector, SCAN_CHUNK);
+		}
+		return span / SCAN_CHUNK;
+	case REREAD:
+		for (i = 0; i < HOT_ACCESSES; i++) {
+			sector = next_rand() % HOT_SECTORS;
+			if (cached)
+				bcache_read(&cache, buf, sector, 1);
+			else
+				blkdev_driver_read(&blkdrv, buf, sector, 1);
+		}
+		return HOT_ACCESSES;
+	case UPDATE:
+		for (i = 0; i < HOT_ACCESSES; i++) {
+			sector = next_rand() % HOT_SECTORS;
+			fill_sector(buf[0], sector, i);
+			if (cached)
+				bcache_write(&cache, sector, buf, 1);
+			else
+				blkdev_driver_write(&blkdrv, buf, sector, 1);
+		}
+		if (cached)
+			bcache_flush(&cache);
+		return HOT_ACCESSES;
+	default:
+		return 0;
+	}
+}
+
+// Both runs of the update phase leave each hot sector holding the last
+// value written to it, so check the disk has it
+static void check_update(void)
+{
+	unsigned int last[HOT_SECTORS];
+	unsigned int sector;
+	int i;
+
+	rand_state = 1;
+	for (i = 0; i < HOT_ACCESSES; i++)
+		last[next_rand() % HOT_SECTORS] = i;
+
+	rand_state = 1;
+	for (i = 0; i < HOT_ACCESSES; i++) {
+		sector = next_rand() % HOT_SECTORS;
+		if (last[sector] != i)
+			continue;
+		fill_sector(buf[0], sector, i);
+		blkdev_driver_read(&blkdrv, check_buf, sector, 1);
+		if (memcmp(buf[0], check_buf, BLKDEV_SECTOR_SIZE) != 0) {
+			printf("Sector %u does not hold write %d\n", sector, i);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned int nsectors = blkdev_nsectors();
+	unsigned int span = nsectors < SCAN_SECTORS ? nsectors : SCAN_SECTORS;
+	unsigned long start, uncached, cached, lookups;
+	struct bcache_stats before;
+	int phase, accesses;
+
+	if (span < HOT_SECTORS) {
+		printf("Error: blkdev nsectors not large enough: %u < %u\n",
+				nsectors, HOT_SECTORS);
+		return 1;
+	}
+
+	blkdev_driver_init(&blkdrv);
+	bcache_init(&cache, &blkdrv);
+
+	printf("bcache-bench,phase,accesses,uncached_cycles,cached_cycles,"
+		"saved_cycles,hit_pct,readahead_hits,writebacks\n");
+
+	for (phase = 0; phase < NPHASES; phase++) {
+		start = rdcycle();
+		accesses = run_phase(phase, span, 0);
+		uncached = rdcycle() - start;
+
+		before = cache.stats;
+		start = rdcycle();
+		run_phase(phase, span, 1);
+		cached = rdcycle() - start;
+
+		lookups = (cache.stats.hits - before.hits) +
+			(cache.stats.misses - before.misses);
+
+		printf("bcache-bench,%s,%d,%lu,%lu,%ld,%lu,%lu,%lu\n",
+			phase_names[phase], accesses, uncached, cached,
+			(long) (uncached - cached),
+			(cache.stats.hits - before.hits) * 100 / lookups,
+			cache.stats.readahead_hits - before.readahead_hits,
+			cache.stats.writebacks - before.writebacks);
+	}
+
+	check_update();
+
+	printf("All correct\n");
+
+	return 0;
+}
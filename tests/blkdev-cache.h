@@ -0,0 +1,372 @@
+#ifndef __BLKDEV_CACHE_H__
+#define __BLKDEV_CACHE_H__
+
+// Sector buffer cache on top of the asynchronous block device driver.
+//
+// The cache holds BCACHE_NENTRIES sectors, found through a hash table and
+// evicted in least recently used order. Reads that miss are all sent to
+// the driver before waiting on any of them, so a multi-sector miss uses
+// every tracker. Once two reads in a row are sequential, the cache also
+// reads ahead the next BCACHE_READAHEAD sectors in the background.
+//
+// Writes only update the cache. A dirty sector is written back when it is
+// evicted, when it has been dirty for BCACHE_FLUSH_INTERVAL cycles (checked
+// by bcache_poll(), which the cache calls on every access and programs can
+// call while otherwise idle), or when the program calls bcache_flush().
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "encoding.h"
+#include "blkdev-driver.h"
+
+// Must be powers of two
+#define BCACHE_NENTRIES 64
+#define BCACHE_HASH_SIZE 64
+#define BCACHE_READAHEAD 8
+// Misses started together before the first wait
+#define BCACHE_BATCH 16
+#define BCACHE_FLUSH_INTERVAL 100000
+
+#define BCACHE_SECTOR_WORDS (BLKDEV_SECTOR_SIZE / sizeof(uint64_t))
+#define BCACHE_NONE -1
+
+// VALID: data matches the disk or a later write. BUSY: disk I/O in flight.
+// DIRTY: written since the last writeback. READAHEAD: read ahead and not
+// yet used.
+#define BCACHE_VALID 1
+#define BCACHE_BUSY 2
+#define BCACHE_DIRTY 4
+#define BCACHE_READAHEAD_FLAG 8
+
+struct bcache_entry {
+	uint64_t data[BCACHE_SECTOR_WORDS];
+	unsigned int sector;
+	int flags;
+	// LRU list, most recently used first, and the hash chain
+	int prev, next;
+	int hnext;
+	unsigned long dirty_cycle;
+	struct blkdev_request req;
+} __attribute__((aligned(64)));
+
+struct bcache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long readaheads;
+	unsigned long readahead_hits;
+	unsigned long writebacks;
+};
+
+struct bcache {
+	struct bcache_entry entries[BCACHE_NENTRIES];
+	int hash[BCACHE_HASH_SIZE];
+	int lru_head, lru_tail;
+	struct blkdev_driver *drv;
+	unsigned int nsectors;
+	// Sequential read detection
+	unsigned int next_sector;
+	unsigned int ra_end;
+	unsigned long last_flush;
+	struct bcache_stats stats;
+};
+
+static inline struct bcache_entry *bcache_req_entry(struct blkdev_request *req)
+{
+	return (struct bcache_entry *)
+		((uint8_t *) req - offsetof(struct bcache_entry, req));
+}
+
+static void bcache_io_done(struct blkdev_request *req)
+{
+	struct bcache_entry *ent = bcache_req_entry(req);
+
+	if (!req->write)
+		ent->flags |= BCACHE_VALID;
+	ent->flags &= ~BCACHE_BUSY;
+}
+
+static void bcache_start_io(struct bcache *c, int idx, int write)
+{
+	struct bcache_entry *ent = &c->entries[idx];
+
+	ent->req.addr = ent->data;
+	ent->req.offset = ent->sector;
+	ent->req.len = 1;
+	ent->req.write = write;
+	ent->req.callback = bcache_io_done;
+	ent->req.priv = c;
+
+	ent->flags |= BCACHE_BUSY;
+	if (write) {
+		ent->flags &= ~BCACHE_DIRTY;
+		c->stats.writebacks++;
+	}
+
+	blkdev_submit(c->drv, &ent->req);
+}
+
+static inline void bcache_wait(struct bcache *c, int idx)
+{
+	while (c->entries[idx].flags & BCACHE_BUSY)
+		blkdev_driver_poll(c->drv);
+}
+
+static void bcache_lru_unlink(struct bcache *c, int idx)
+{
+	struct bcache_entry *ent = &c->entries[idx];
+
+	if (ent->prev == BCACHE_NONE)
+		c->lru_head = ent->next;
+	else
+		c->entries[ent->prev].next = ent->next;
+
+	if (ent->next == BCACHE_NONE)
+		c->lru_tail = ent->prev;
+	else
+		c->entries[ent->next].prev = ent->prev;
+}
+
+static void bcache_lru_push(struct bcache *c, int idx)
+{
+	struct bcache_entry *ent = &c->entries[idx];
+
+	ent->prev = BCACHE_NONE;
+	ent->next = c->lru_head;
+	if (c->lru_head == BCACHE_NONE)
+		c->lru_tail = idx;
+	else
+		c->entries[c->lru_head].prev = idx;
+	c->lru_head = idx;
+}
+
+static inline void bcache_touch(struct bcache *c, int idx)
+{
+	if (c->lru_head != idx) {
+		bcache_lru_unlink(c, idx);
+		bcache_lru_push(c, idx);
+	}
+}
+
+static int bcache_lookup(struct bcache *c, unsigned int sector)
+{
+	int idx = c->hash[sector & (BCACHE_HASH_SIZE - 1)];
+
+	while (idx != BCACHE_NONE && c->entries[idx].sector != sector)
+		idx = c->entries[idx].hnext;
+
+	return idx;
+}
+
+static void bcache_hash_remove(struct bcache *c, int idx)
+{
+	int *link = &c->hash[c->entries[idx].sector & (BCACHE_HASH_SIZE - 1)];
+
+	while (*link != idx)
+		link = &c->entries[*link].hnext;
+	*link = c->entries[idx].hnext;
+}
+
+// Free the least recently used entry that is clean and has no I/O in
+// flight. Dirty entries passed over on the way get their writeback started,
+// so if everything is dirty we only wait for the first of them.
+static int bcache_evict(struct bcache *c)
+{
+	int idx;
+
+	for (;;) {
+		for (idx = c->lru_tail; idx != BCACHE_NONE;
+				idx = c->entries[idx].prev) {
+			int flags = c->entries[idx].flags;
+
+			// Covers entries in the batch being read, which are
+			// either busy or near the head of the list
+			if (flags & BCACHE_BUSY)
+				continue;
+			if (flags & BCACHE_DIRTY) {
+				bcache_start_io(c, idx, 1);
+				continue;
+			}
+			if (flags & BCACHE_VALID)
+				bcache_hash_remove(c, idx);
+			c->entries[idx].flags = 0;
+			return idx;
+		}
+		blkdev_driver_poll(c->drv);
+	}
+}
+
+// Return the entry for a sector, allocating one on a miss. If fill is set
+// a missing sector is read from the disk, and the caller must bcache_wait()
+// before using the data.
+static int bcache_get(struct bcache *c, unsigned int sector, int fill)
+{
+	struct bcache_entry *ent;
+	int idx = bcache_lookup(c, sector);
+
+	if (idx != BCACHE_NONE) {
+		ent = &c->entries[idx];
+		if (ent->flags & BCACHE_READAHEAD_FLAG) {
+			ent->flags &= ~BCACHE_READAHEAD_FLAG;
+			c->stats.readahead_hits++;
+		}
+		c->stats.hits++;
+		bcache_touch(c, idx);
+		return idx;
+	}
+
+	c->stats.misses++;
+	idx = bcache_evict(c);
+	ent = &c->entries[idx];
+	ent->sector = sector;
+	ent->flags = BCACHE_VALID;
+	ent->hnext = c->hash[sector & (BCACHE_HASH_SIZE - 1)];
+	c->hash[sector & (BCACHE_HASH_SIZE - 1)] = idx;
+	bcache_touch(c, idx);
+
+	if (fill) {
+		ent->flags = 0;
+		bcache_start_io(c, idx, 0);
+	}
+
+	return idx;
+}
+
+static void bcache_readahead(struct bcache *c, unsigned int end)
+{
+	unsigned int sector, stop = end + BCACHE_READAHEAD;
+	int idx;
+
+	if (stop > c->nsectors)
+		stop = c->nsectors;
+
+	for (sector = (c->ra_end > end) ? c->ra_end : end;
+			sector < stop; sector++) {
+		if (bcache_lookup(c, sector) != BCACHE_NONE)
+			continue;
+		idx = bcache_get(c, sector, 1);
+		// Not a demand miss
+		c->stats.misses--;
+		c->stats.readaheads++;
+		c->entries[idx].flags |= BCACHE_READAHEAD_FLAG;
+	}
+
+	if (stop > c->ra_end)
+		c->ra_end = stop;
+}
+
+// Reap I/O and start writeback of sectors that have been dirty too long
+static void bcache_poll(struct bcache *c)
+{
+	unsigned long now = rdcycle();
+	int idx;
+
+	blkdev_driver_poll(c->drv);
+
+	if (now - c->last_flush < BCACHE_FLUSH_INTERVAL)
+		return;
+	c->last_flush = now;
+
+	for (idx = 0; idx < BCACHE_NENTRIES; idx++) {
+		struct bcache_entry *ent = &c->entries[idx];
+
+		if ((ent->flags & BCACHE_DIRTY) &&
+				now - ent->dirty_cycle >= BCACHE_FLUSH_INTERVAL)
+			bcache_start_io(c, idx, 1);
+	}
+}
+
+static void bcache_read(struct bcache *c, void *buf,
+		unsigned int sector, unsigned int nsectors)
+{
+	int idx[BCACHE_BATCH];
+	int sequential = (sector == c->next_sector);
+	unsigned int n, i;
+
+	bcache_poll(c);
+	c->next_sector = sector + nsectors;
+	if (!sequential)
+		c->ra_end = 0;
+
+	while (nsectors > 0) {
+		n = (nsectors < BCACHE_BATCH) ? nsectors : BCACHE_BATCH;
+
+		for (i = 0; i < n; i++)
+			idx[i] = bcache_get(c, sector + i, 1);
+
+		// Get the readahead going before waiting on the misses
+		if (sequential)
+			bcache_readahead(c, sector + n);
+		blkdev_driver_poll(c->drv);
+
+		for (i = 0; i < n; i++) {
+			bcache_wait(c, idx[i]);
+			memcpy(buf, c->entries[idx[i]].data, BLKDEV_SECTOR_SIZE);
+			buf = (uint8_t *) buf + BLKDEV_SECTOR_SIZE;
+		}
+
+		sector += n;
+		nsectors -= n;
+	}
+}
+
+static void bcache_write(struct bcache *c, unsigned int sector,
+		const void *buf, unsigned int nsectors)
+{
+	struct bcache_entry *ent;
+	int idx;
+
+	bcache_poll(c);
+
+	for (; nsectors > 0; nsectors--, sector++) {
+		// Whole sectors are written, so a miss needs no read
+		idx = bcache_get(c, sector, 0);
+		bcache_wait(c, idx);
+
+		ent = &c->entries[idx];
+		memcpy(ent->data, buf, BLKDEV_SECTOR_SIZE);
+		if (!(ent->flags & BCACHE_DIRTY))
+			ent->dirty_cycle = rdcycle();
+		ent->flags = (ent->flags & ~BCACHE_READAHEAD_FLAG) |
+			BCACHE_VALID | BCACHE_DIRTY;
+
+		buf = (const uint8_t *) buf + BLKDEV_SECTOR_SIZE;
+	}
+}
+
+// Write back every dirty sector and wait for the disk to catch up
+static void bcache_flush(struct bcache *c)
+{
+	// Writes wait for an entry's I/O to finish, and starting a writeback
+	// clears DIRTY, so a dirty entry is never busy
+	for (int idx = 0; idx < BCACHE_NENTRIES; idx++) {
+		if (c->entries[idx].flags & BCACHE_DIRTY)
+			bcache_start_io(c, idx, 1);
+	}
+	blkdev_driver_wait(c->drv);
+	c->last_flush = rdcycle();
+}
+
+static void bcache_init(struct bcache *c, struct blkdev_driver *drv)
+{
+	int i;
+
+	for (i = 0; i < BCACHE_HASH_SIZE; i++)
+		c->hash[i] = BCACHE_NONE;
+
+	c->lru_head = c->lru_tail = BCACHE_NONE;
+	for (i = 0; i < BCACHE_NENTRIES; i++) {
+		c->entries[i].flags = 0;
+		c->entries[i].hnext = BCACHE_NONE;
+		bcache_lru_push(c, i);
+	}
+
+	c->drv = drv;
+	c->nsectors = blkdev_nsectors();
+	c->next_sector = c->ra_end = 0;
+	c->last_flush = rdcycle();
+	memset(&c->stats, 0, sizeof(c->stats));
+}
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef __BLKDEV_DRIVER_H__
+#define __BLKDEV_DRIVER_H__
+
+// Asynchronous block device driver.
+//
+// Programs fill in a struct blkdev_request, which they own until its
+// callback runs, and queue it with blkdev_submit(). A request may be any
+// length. blkdev_driver_poll() reaps completed device requests, runs the
+// callbacks of the requests they finish, and hands the device as much of
+// the queue as it has free trackers for.
+//
+// Requests longer than the device's maximum request length are split into
+// maximum length pieces, and those pieces are spread over all the trackers,
+// so one large transfer keeps the whole device busy. Going the other way, a
+// queued request that continues the previous one on disk and in memory, in
+// the same direction, is merged into the same device request as long as the
+// result fits in the maximum length.
+//
+// Requests only reach the device in blkdev_driver_poll(), so submitting a
+// batch before polling gives adjacent requests a chance to merge.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mmio.h"
+#include "blkdev.h"
+
+// Upper bound on the number of trackers the controller can have
+#define BLKDEV_MAX_TAGS 16
+
+struct blkdev_request;
+
+typedef void (*blkdev_callback_t)(struct blkdev_request *req);
+
+struct blkdev_request {
+	void *addr;
+	unsigned int offset;
+	unsigned int len;
+	int write;
+	// Called once every sector of the request has completed. May be NULL.
+	blkdev_callback_t callback;
+	void *priv;
+
+	// Private to the driver
+	unsigned int issued;
+	unsigned int completed;
+	struct blkdev_request *next;
+};
+
+// One device request: the first piece covers len sectors of req, and any
+// requests merged behind it are chained through their next pointers
+struct blkdev_tag {
+	struct blkdev_request *req;
+	unsigned int len;
+	struct blkdev_request *merged;
+};
+
+struct blkdev_driver {
+	struct blkdev_request *head;
+	struct blkdev_request *tail;
+	struct blkdev_tag tags[BLKDEV_MAX_TAGS];
+	unsigned int max_req_len;
+	int inflight;
+	// Device requests issued, and submitted requests merged into another
+	unsigned long commands;
+	unsigned long merges;
+};
+
+static void blkdev_driver_init(struct blkdev_driver *drv)
+{
+	drv->head = drv->tail = NULL;
+	drv->max_req_len = blkdev_max_req_len();
+	drv->inflight = 0;
+	drv->commands = 0;
+	drv->merges = 0;
+}
+
+static inline void blkdev_submit(struct blkdev_driver *drv,
+		struct blkdev_request *req)
+{
+	req->issued = 0;
+	req->completed = 0;
+	req->next = NULL;
+
+	if (drv->tail == NULL)
+		drv->head = req;
+	else
+		drv->tail->next = req;
+	drv->tail = req;
+}
+
+static inline int blkdev_driver_busy(struct blkdev_driver *drv)
+{
+	return drv->head != NULL || drv->inflight > 0;
+}
+
+static inline int blkdev_can_merge(struct blkdev_request *prev,
+		struct blkdev_request *req)
+{
+	return req->write == prev->write &&
+		req->offset == prev->offset + prev->len &&
+		(uint8_t *) req->addr == (uint8_t *) prev->addr +
+			((unsigned long) prev->len << BLKDEV_SECTOR_SHIFT);
+}
+
+// Send the request at the head of the queue, or the next piece of it, with
+// as many following requests merged in as fit
+static void blkdev_issue_one(struct blkdev_driver *drv)
+{
+	struct blkdev_request *req = drv->head, *last = req, *next;
+	unsigned int len = req->len - req->issued;
+	unsigned int total;
+	struct blkdev_tag *tag;
+	int tagnum;
+
+	if (len > drv->max_req_len)
+		len = drv->max_req_len;
+	total = len;
+	req->issued += len;
+
+	if (req->issued < req->len) {
+		// Only part of the head fits, so nothing can merge behind it
+		next = req;
+	} else {
+		next = req->next;
+		while (next != NULL && blkdev_can_merge(last, next) &&
+				total + next->len <= drv->max_req_len) {
+			total += next->len;
+			next->issued = next->len;
+			last = next;
+			next = next->next;
+			drv->merges++;
+		}
+		// Requests merged behind the head stay chained to it
+		last->next = NULL;
+	}
+
+	tagnum = blkdev_send_request(
+		(unsigned long) req->addr +
+			((unsigned long) (req->issued - len) << BLKDEV_SECTOR_SHIFT),
+		req->offset + req->issued - len, total, req->write);
+
+	tag = &drv->tags[tagnum];
+	tag->req = req;
+	tag->len = len;
+	tag->merged = (last == req) ? NULL : req->next;
+
+	drv->head = next;
+	if (next == NULL)
+		drv->tail = NULL;
+	drv->inflight++;
+	drv->commands++;
+}
+
+static inline void blkdev_request_done(struct blkdev_request *req,
+		unsigned int len)
+{
+	req->completed += len;
+	if (req->completed == req->len && req->callback != NULL)
+		req->callback(req);
+}
+
+// Reap completions, running callbacks, then refill the device from the
+// queue. Returns the number of device requests that completed.
+static int blkdev_driver_poll(struct blkdev_driver *drv)
+{
+	struct blkdev_request *req, *next;
+	struct blkdev_tag *tag;
+	int ncomplete, nfree, i;
+
+	ncomplete = reg_read8(BLKDEV_NCOMPLETE);
+
+	// Make sure data read from the disk is visible to the callbacks
+	if (ncomplete > 0)
+		asm volatile ("fence");
+
+	for (i = 0; i < ncomplete; i++) {
+		tag = &drv->tags[reg_read8(BLKDEV_COMPLETE)];
+		blkdev_request_done(tag->req, tag->len);
+		for (req = tag->merged; req != NULL; req = next) {
+			// The callback may reuse the request
+			next = req->next;
+			blkdev_request_done(req, req->len);
+		}
+		drv->inflight--;
+	}
+
+	if (drv->head != NULL) {
+		nfree = reg_read8(BLKDEV_NREQUEST);
+		while (nfree-- > 0 && drv->head != NULL)
+			blkdev_issue_one(drv);
+	}
+
+	return ncomplete;
+}
+
+// Poll until every submitted request has completed
+static void blkdev_driver_wait(struct blkdev_driver *drv)
+{
+	while (blkdev_driver_busy(drv))
+		blkdev_driver_poll(drv);
+}
+
+// Synchronous transfers of any length
+static void blkdev_driver_rw(struct blkdev_driver *drv, void *addr,
+		unsigned int offset, unsigned int nsectors, int write)
+{
+	struct blkdev_request req = {
+		.addr = addr,
+		.offset = offset,
+		.len = nsectors,
+		.write = write,
+		.callback = NULL,
+	};
+
+	blkdev_submit(drv, &req);
+	blkdev_driver_wait(drv);
+}
+
+static inline void blkdev_driver_read(struct blkdev_driver *drv, void *addr,
+		unsigned int offset, unsigned int nsectors)
+{
+	blkdev_driver_rw(drv, addr, offset, nsectors, 0);
+}
+
+static inline void blkdev_driver_write(struct blkdev_driver *drv, void *addr,
+		unsigned int offset, unsigned int nsectors)
+{
+	blkdev_driver_rw(drv, addr, offset, nsectors, 1);
+}
+
+#endif
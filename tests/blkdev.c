@@ -2,66 +2,24 @@
 #include <stdio.h>
 
 #include "mmio.h"
-#include "blkdev.h"
+#include "blkdev-driver.h"
 
-void blkdev_read(void *addr, unsigned long offset, size_t nsectors)
-{
-	int req_tag, resp_tag, ntags, i;
-	size_t nsectors_per_tag;
-
-	ntags = reg_read8(BLKDEV_NREQUEST);
-	nsectors_per_tag = nsectors / ntags;
-
-	printf("sending %d reads\n", ntags);
-
-	for (i = 0; i < ntags; i++) {
-		req_tag = blkdev_send_request(
-				(unsigned long) addr, offset,
-				nsectors_per_tag, 0);
-		addr += (nsectors_per_tag << BLKDEV_SECTOR_SHIFT);
-		offset += nsectors_per_tag;
-	}
+#define TEST_NSECTORS 4
+#define SECTOR_INTS (BLKDEV_SECTOR_SIZE / sizeof(int))
+#define TEST_SIZE (TEST_NSECTORS * SECTOR_INTS)
 
-	while (reg_read8(BLKDEV_NCOMPLETE) < ntags);
+unsigned int test_data[TEST_SIZE];
+unsigned int res_data[TEST_SIZE];
 
-	for (i = 0; i < ntags; i++) {
-		resp_tag = reg_read8(BLKDEV_COMPLETE);
-		printf("completed read %d\n", resp_tag);
-	}
-}
+struct blkdev_driver blkdrv;
+struct blkdev_request writes[TEST_NSECTORS];
+int writes_done;
 
-void blkdev_write(unsigned long offset, void *addr, size_t nsectors)
+void write_done(struct blkdev_request *req)
 {
-	int req_tag, resp_tag, ntags, i;
-	size_t nsectors_per_tag;
-
-	ntags = reg_read8(BLKDEV_NREQUEST);
-	nsectors_per_tag = nsectors / ntags;
-
-	printf("sending %d writes\n", ntags);
-
-	for (i = 0; i < ntags; i++) {
-		req_tag = blkdev_send_request(
-				(unsigned long) addr, offset,
-				nsectors_per_tag, 1);
-		addr += (nsectors_per_tag << BLKDEV_SECTOR_SHIFT);
-		offset += nsectors_per_tag;
-	}
-
-	while (reg_read8(BLKDEV_NCOMPLETE) < ntags);
-
-	for (i = 0; i < ntags; i++) {
-		resp_tag = reg_read8(BLKDEV_COMPLETE);
-		printf("completed write %d\n", resp_tag);
-	}
+	writes_done++;
 }
 
-#define TEST_NSECTORS 4
-#define TEST_SIZE (TEST_NSECTORS * BLKDEV_SECTOR_SIZE / sizeof(int))
-
-unsigned int test_data[TEST_SIZE];
-unsigned int res_data[TEST_SIZE];
-
 int main(void)
 {
 	unsigned int nsectors = blkdev_nsectors();
@@ -73,12 +31,6 @@ int main(void)
 		return 1;
 	}
 
-	if (max_req_len < TEST_NSECTORS) {
-		printf("Error: blkdev max_req_len not large enough: %u < %u\n",
-				max_req_len, TEST_NSECTORS);
-		return 1;
-	}
-
 	printf("blkdev: %u sectors %u max request length\n",
 			nsectors, max_req_len);
 
@@ -88,8 +40,30 @@ int main(void)
 
 	asm volatile ("fence");
 
-	blkdev_write(0, (void *) test_data, TEST_NSECTORS);
-	blkdev_read((void *) res_data, 0, TEST_NSECTORS);
+	blkdev_driver_init(&blkdrv);
+
+	// Write one sector per request so the driver merges them, then read
+	// everything back with a single request, which it splits if needed
+	for (int i = 0; i < TEST_NSECTORS; i++) {
+		writes[i].addr = &test_data[i * SECTOR_INTS];
+		writes[i].offset = i;
+		writes[i].len = 1;
+		writes[i].write = 1;
+		writes[i].callback = write_done;
+		blkdev_submit(&blkdrv, &writes[i]);
+	}
+	blkdev_driver_wait(&blkdrv);
+
+	if (writes_done != TEST_NSECTORS) {
+		printf("Error: %d of %d write callbacks ran\n",
+				writes_done, TEST_NSECTORS);
+		return 1;
+	}
+
+	blkdev_driver_read(&blkdrv, (void *) res_data, 0, TEST_NSECTORS);
+
+	printf("%lu device requests, %lu merged\n",
+			blkdrv.commands, blkdrv.merges);
 
 	for (int i = 0; i < TEST_SIZE; i++) {
 		if (test_data[i] != res_data[i]) {
@@ -1,3 +1,10 @@
+#ifndef __BLKDEV_H__
+#define __BLKDEV_H__
+
+#include <stddef.h>
+
+#include "mmio.h"
+
 #define BLKDEV_BASE 0x10015000
 #define BLKDEV_ADDR BLKDEV_BASE
 #define BLKDEV_OFFSET (BLKDEV_BASE + 8)
@@ -36,3 +43,5 @@ static inline unsigned int blkdev_send_request(
 		asm volatile ("fence");
 		return reg_read8(BLKDEV_REQUEST);
 }
+
+#endif
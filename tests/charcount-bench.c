@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rocc.h"
+#include "stream-charcount.h"
+#include "encoding.h"
+
+// Character counting throughput on RoccExampleConfig: a software scan,
+// the CharacterCountExample RoCC (custom2, one needle per call, stops at
+// a NUL) and the StreamingCharCount RoCC (custom3, up to eight needles
+// per pass).
+//
+// Each combination of buffer size and needle count is run with the buffer
+// in the L1 data cache ("warm") and with it evicted ("cold"). The issue
+// column is how long stream_count_start() held the core.
+//
+// Results are CSV rows prefixed with "charcount-bench", the first of which
+// holds the column names. Bandwidth is in bytes per kilocycle.
+
+#define MAX_SIZE 65536
+// Twice the L1 data cache
+#define EVICT_SIZE 32768
+
+static const int sizes[] = {64, 256, 1024, 4096, 16384, MAX_SIZE};
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static const int nneedles[] = {1, 4};
+#define NNEEDLES (sizeof(nneedles) / sizeof(nneedles[0]))
+
+static const char needles[] = "etao";
+
+enum cache_state { COLD, WARM, NSTATES };
+
+static const char *state_names[] = { "cold", "warm" };
+
+// One extra byte for the NUL CharacterCountExample needs
+char buffer[MAX_SIZE + 64] __attribute__((aligned(64)));
+char evict[EVICT_SIZE] __attribute__((aligned(64)));
+
+static unsigned long __attribute__((noinline)) sw_count(
+		const char *buf, int len, int n)
+{
+	unsigned long count = 0;
+
+	for (int i = 0; i < len; i++) {
+		for (int j = 0; j < n; j++)
+			count += (buf[i] == needles[j]);
+	}
+
+	return count;
+}
+
+static inline unsigned long rocc_count(char *start, char needle)
+{
+	unsigned long count;
+	asm volatile ("fence");
+	ROCC_INSTRUCTION_DSS(2, count, start, needle, 0);
+	return count;
+}
+
+static void set_cache_state(enum cache_state state, int len)
+{
+	volatile char *p;
+	int i;
+
+	if (state == WARM) {
+		p = buffer;
+		for (i = 0; i < len; i += 64)
+			(void) p[i];
+	} else {
+		p = evict;
+		for (i = 0; i < EVICT_SIZE; i += 64)
+			p[i]++;
+	}
+	asm volatile ("fence");
+}
+
+static void run_test(int len, int n, enum cache_state state)
+{
+	unsigned long start, sw_cycles, cc_cycles, stream_cycles, issue_cycles;
+	unsigned long sw, cc = 0, stream;
+	char saved = buffer[len];
+	int i;
+
+	buffer[len] = '\0';
+
+	set_cache_state(state, len);
+	start = rdcycle();
+	sw = sw_count(buffer, len, n);
+	sw_cycles = rdcycle() - start;
+
+	set_cache_state(state, len);
+	start = rdcycle();
+	for (i = 0; i < n; i++)
+		cc += rocc_count(buffer, needles[i]);
+	cc_cycles = rdcycle() - start;
+
+	set_cache_state(state, len);
+	start = rdcycle();
+	stream_count_set_needles(needles, n);
+	stream_count_start(buffer, len);
+	issue_cycles = rdcycle() - start;
+	stream = stream_count_result(STREAM_COUNT_TOTAL);
+	stream_cycles = rdcycle() - start;
+
+	buffer[len] = saved;
+
+	if (sw != cc || sw != stream) {
+		printf("Count mismatch len %d needles %d: "
+				"software %lu, charcount %lu, streaming %lu\n",
+				len, n, sw, cc, stream);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("charcount-bench,%d,%d,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+		len, n, state_names[state], sw,
+		sw_cycles, cc_cycles, stream_cycles, issue_cycles,
+		(unsigned long) len * 1000 / sw_cycles,
+		(unsigned long) len * 1000 / stream_cycles);
+}
+
+int main(void)
+{
+	unsigned long seed = 1;
+	int i, j, k;
+
+	// Printable text with no NULs, so CharacterCountExample sees the
+	// whole buffer
+	for (i = 0; i < sizeof(buffer); i++) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		buffer[i] = 'a' + (seed >> 33) % 26;
+	}
+
+	printf("charcount-bench,size,needles,cache,count,sw_cycles,"
+		"charcount_cycles,stream_cycles,stream_issue_cycles,"
+		"sw_bytes_per_kcycle,stream_bytes_per_kcycle\n");
+
+	for (i = 0; i < NSIZES; i++) {
+		for (j = 0; j < NNEEDLES; j++) {
+			for (k = 0; k < NSTATES; k++)
+				run_test(sizes[i], nneedles[j], k);
+		}
+	}
+
+	printf("All correct\n");
+
+	return 0;
+}
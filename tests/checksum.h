@@ -0,0 +1,117 @@
+#ifndef __CHECKSUM_H__
+#define __CHECKSUM_H__
+
+// Internet checksum (RFC 1071) and incremental update (RFC 1624).
+//
+// The one's complement sum does not depend on byte order, so these work
+// directly on little-endian loads of network-order data. The results are
+// in network order as they sit in memory: store them into a header without
+// htons(), and compare them against a header field without ntohs().
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fold a 64-bit partial sum down to 16 bits with end-around carries
+static inline uint16_t csum_fold(uint64_t sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
+// Add len bytes at buf to a partial sum. buf must be 2-byte aligned. The
+// bulk of the buffer is summed eight bytes per load, four loads per
+// iteration, with the carries out of bit 63 counted separately and added
+// back at the end.
+static uint64_t csum_partial(const void *buf, size_t len, uint64_t sum)
+{
+	const uint8_t *p = buf;
+	const uint64_t *w;
+	uint64_t sum2 = 0, tail = 0, carry = 0;
+
+	while (((uintptr_t) p & 7) != 0 && len >= 2) {
+		tail += *(const uint16_t *) p;
+		p += 2;
+		len -= 2;
+	}
+
+	w = (const uint64_t *) p;
+	while (len >= 32) {
+		uint64_t a = w[0], b = w[1], c = w[2], d = w[3];
+
+		// Two accumulators so the adds of a and b, and of c and d,
+		// do not wait on each other
+		sum += a;
+		carry += sum < a;
+		sum2 += b;
+		carry += sum2 < b;
+		sum += c;
+		carry += sum < c;
+		sum2 += d;
+		carry += sum2 < d;
+
+		w += 4;
+		len -= 32;
+	}
+
+	while (len >= 8) {
+		uint64_t a = *w++;
+		sum += a;
+		carry += sum < a;
+		len -= 8;
+	}
+
+	p = (const uint8_t *) w;
+	if (len >= 4) {
+		tail += *(const uint32_t *) p;
+		p += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		tail += *(const uint16_t *) p;
+		p += 2;
+		len -= 2;
+	}
+	// A trailing odd byte is the high byte of a network-order word
+	// padded with zero, which is the low byte of a little-endian load
+	if (len > 0)
+		tail += *p;
+
+	sum += sum2;
+	carry += sum < sum2;
+	sum += tail;
+	carry += sum < tail;
+	sum += carry;
+	sum += sum < carry;
+
+	return sum;
+}
+
+// Checksum of a buffer. Returns zero when run over data that already
+// contains a valid checksum.
+static inline uint16_t csum(const void *buf, size_t len)
+{
+	return ~csum_fold(csum_partial(buf, len, 0));
+}
+
+// Update a checksum after a 16-bit field changed from old to new, using
+// eqn. 3 of RFC 1624: HC' = ~(~HC + ~m + m')
+static inline uint16_t csum_replace2(uint16_t check, uint16_t old, uint16_t new)
+{
+	uint32_t sum = (uint16_t) ~check + (uint16_t) ~old + (uint32_t) new;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+// The same for a 32-bit field, such as an IPv4 address
+static inline uint16_t csum_replace4(uint16_t check, uint32_t old, uint32_t new)
+{
+	check = csum_replace2(check, old & 0xffff, new & 0xffff);
+	return csum_replace2(check, old >> 16, new >> 16);
+}
+
+#endif
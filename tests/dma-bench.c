@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dma.h"
+#include "encoding.h"
+
+// Compares the software memcpy and memset in syscalls.c against the
+// RoccDMA engine on RoccDMAConfig, from 64 bytes to 1 MiB.
+//
+// Results are CSV rows prefixed with "dma-bench", the first of which holds
+// the column names. Bandwidth is in bytes per kilocycle.
+
+#define MAX_SIZE (1 << 20)
+#define MAX_WORDS (MAX_SIZE / sizeof(uint64_t))
+
+uint64_t src[MAX_WORDS];
+uint64_t dst[MAX_WORDS];
+
+static void check_copy(size_t len)
+{
+	for (size_t i = 0; i < len / sizeof(uint64_t); i++) {
+		if (dst[i] != src[i]) {
+			printf("memcpy of %lu bytes wrong at word %lu: "
+					"%lx != %lx\n", len, i, dst[i], src[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void check_fill(size_t len, int byte)
+{
+	uint64_t pattern = (uint8_t) byte * 0x0101010101010101UL;
+
+	for (size_t i = 0; i < len / sizeof(uint64_t); i++) {
+		if (dst[i] != pattern) {
+			printf("memset of %lu bytes wrong at word %lu: "
+					"%lx != %lx\n", len, i, dst[i], pattern);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void run_size(size_t len)
+{
+	unsigned long start, sw_cpy, dma_cpy, sw_set, dma_set;
+
+	memset(dst, 0, len);
+	start = rdcycle();
+	memcpy(dst, src, len);
+	sw_cpy = rdcycle() - start;
+	check_copy(len);
+
+	memset(dst, 0, len);
+	start = rdcycle();
+	dma_memcpy(dst, src, len);
+	dma_cpy = rdcycle() - start;
+	check_copy(len);
+
+	start = rdcycle();
+	memset(dst, 0x5a, len);
+	sw_set = rdcycle() - start;
+	check_fill(len, 0x5a);
+
+	start = rdcycle();
+	dma_memset(dst, 0xa5, len);
+	dma_set = rdcycle() - start;
+	check_fill(len, 0xa5);
+
+	printf("dma-bench,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+		len, sw_cpy, dma_cpy, sw_set, dma_set,
+		len * 1000 / sw_cpy, len * 1000 / dma_cpy,
+		len * 1000 / sw_set, len * 1000 / dma_set);
+}
+
+int main(void)
+{
+	size_t len;
+
+	for (size_t i = 0; i < MAX_WORDS; i++)
+		src[i] = 0x0123456789abcdefUL * (i + 1);
+
+	printf("dma-bench,size,sw_memcpy_cycles,dma_memcpy_cycles,"
+		"sw_memset_cycles,dma_memset_cycles,"
+		"sw_memcpy_bytes_per_kcycle,dma_memcpy_bytes_per_kcycle,"
+		"sw_memset_bytes_per_kcycle,dma_memset_bytes_per_kcycle\n");
+
+	for (len = 64; len <= MAX_SIZE; len <<= 2)
+		run_size(len);
+
+	printf("All correct\n");
+
+	return 0;
+}
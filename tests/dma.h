@@ -0,0 +1,88 @@
+#ifndef __DMA_H__
+#define __DMA_H__
+
+// Wrappers for the RoccDMA memcpy/memset engine on custom3 (RoccDMAConfig).
+//
+// The engine moves whole 8-byte beats, so dma_memcpy() and dma_memset()
+// copy any unaligned head and tail with the core and give it the aligned
+// middle. Transfers shorter than DMA_MIN_LEN are done entirely in
+// software, since the command round trip costs more than they do.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rocc.h"
+
+#define DMA_ALIGN 8
+#define DMA_MIN_LEN 64
+
+static inline void dma_start_memcpy(void *dst, const void *src, size_t len)
+{
+	// The engine reads memory over TileLink, so earlier stores to the
+	// source must have left the core first
+	asm volatile ("fence");
+	ROCC_INSTRUCTION_S(3, len, 0);
+	ROCC_INSTRUCTION_SS(3, (uintptr_t) dst, (uintptr_t) src, 1);
+}
+
+static inline void dma_start_memset(void *dst, int byte, size_t len)
+{
+	uint64_t pattern = (uint8_t) byte * 0x0101010101010101UL;
+
+	asm volatile ("fence");
+	ROCC_INSTRUCTION_S(3, len, 0);
+	ROCC_INSTRUCTION_SS(3, (uintptr_t) dst, pattern, 2);
+}
+
+// Wait for the last transfer to land in memory
+static inline void dma_wait(void)
+{
+	unsigned long status;
+	ROCC_INSTRUCTION_D(3, status, 3);
+	(void) status;
+}
+
+static inline void *dma_memcpy(void *dst, const void *src, size_t len)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head, body;
+
+	// Only a copy with both ends at the same offset can be split into
+	// aligned beats
+	if (len < DMA_MIN_LEN ||
+			(((uintptr_t) d ^ (uintptr_t) s) & (DMA_ALIGN - 1)) != 0)
+		return memcpy(dst, src, len);
+
+	head = -(uintptr_t) d & (DMA_ALIGN - 1);
+	body = (len - head) & ~(DMA_ALIGN - 1);
+
+	memcpy(d, s, head);
+	memcpy(d + head + body, s + head + body, len - head - body);
+	dma_start_memcpy(d + head, s + head, body);
+	dma_wait();
+
+	return dst;
+}
+
+static inline void *dma_memset(void *dst, int byte, size_t len)
+{
+	uint8_t *d = dst;
+	size_t head, body;
+
+	if (len < DMA_MIN_LEN)
+		return memset(dst, byte, len);
+
+	head = -(uintptr_t) d & (DMA_ALIGN - 1);
+	body = (len - head) & ~(DMA_ALIGN - 1);
+
+	memset(d, byte, head);
+	memset(d + head + body, byte, len - head - body);
+	dma_start_memset(d + head, byte, body);
+	dma_wait();
+
+	return dst;
+}
+
+#endif
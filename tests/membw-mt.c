@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "encoding.h"
+#include "mt.h"
+
+// Aggregate copy bandwidth with 1 to NCORES harts sharing the memory
+// system. Hart 0 runs the sweep from main(); the other harts wait at a
+// barrier for each round and copy their slice of the buffer when they are
+// among the first "threads" harts.
+//
+// Build as membw-mt-<n>c.riscv (make NCORES=n) for an n-core config.
+//
+// Results are CSV rows prefixed with "membw", the first of which holds the
+// column names. Bandwidth is in bytes per kilocycle, counting bytes read
+// and written.
+
+#ifndef MEMBW_BYTES
+#define MEMBW_BYTES (256 * 1024)
+#endif
+#define MEMBW_WORDS (MEMBW_BYTES / sizeof(uint64_t))
+
+uint64_t src[MEMBW_WORDS] __attribute__((aligned(64)));
+uint64_t dst[MEMBW_WORDS] __attribute__((aligned(64)));
+
+static volatile int active_threads;
+
+static void copy_slice(int cid, int threads)
+{
+	size_t words = MEMBW_WORDS / threads;
+	size_t start = cid * words, i;
+
+	for (i = start; i < start + words; i++)
+		dst[i] = src[i];
+}
+
+// Hart 0 runs the whole round; the barriers on either side are what the
+// other harts wait on in thread_entry()
+static unsigned long run_round(int threads, int nc)
+{
+	unsigned long start;
+
+	active_threads = threads;
+	mt_barrier(nc);
+	start = rdcycle();
+	copy_slice(0, threads);
+	mt_barrier(nc);
+	return rdcycle() - start;
+}
+
+void thread_entry(int cid, int nc)
+{
+	int threads;
+
+	if (cid == 0)
+		return;
+
+	for (;;) {
+		mt_barrier(nc);
+		threads = active_threads;
+		if (cid < threads)
+			copy_slice(cid, threads);
+		mt_barrier(nc);
+	}
+}
+
+int main(void)
+{
+	unsigned long cycles, bytes;
+	size_t i;
+	int threads;
+
+	for (i = 0; i < MEMBW_WORDS; i++)
+		src[i] = i * 0x9e3779b97f4a7c15UL;
+
+	printf("membw,threads,bytes,cycles,bytes_per_kcycle\n");
+
+	for (threads = 1; threads <= NCORES; threads++) {
+		// Round down so every thread copies the same amount
+		bytes = (MEMBW_WORDS / threads) * threads * sizeof(uint64_t);
+		cycles = run_round(threads, NCORES);
+
+		for (i = 0; i < bytes / sizeof(uint64_t); i++) {
+			if (dst[i] != src[i]) {
+				printf("Word %lu wrong with %d threads\n",
+					i, threads);
+				exit(EXIT_FAILURE);
+			}
+			dst[i] = 0;
+		}
+
+		printf("membw,%d,%lu,%lu,%lu\n", threads, bytes, cycles,
+			2 * bytes * 1000 / cycles);
+	}
+
+	return 0;
+}
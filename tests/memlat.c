@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "encoding.h"
+
+// Load-to-use latency over a range of working set sizes. Each size is a
+// ring of cache lines linked in a random order, so every load depends on
+// the one before and prefetching cannot help. The L1, L2 and DRAM show up
+// as steps in the latency as the working set outgrows each level.
+//
+// Results are CSV rows prefixed with "memlat", the first of which holds
+// the column names. Latency is printed in cycles per load times 100.
+
+#define LINE_SIZE 64
+#define MIN_SIZE 4096
+#ifndef MEMLAT_MAX_SIZE
+#define MEMLAT_MAX_SIZE (1 << 20)
+#endif
+#define MIN_LOADS 8192
+
+struct line {
+	struct line *next;
+	char pad[LINE_SIZE - sizeof(struct line *)];
+};
+
+struct line lines[MEMLAT_MAX_SIZE / LINE_SIZE] __attribute__((aligned(64)));
+unsigned long order[MEMLAT_MAX_SIZE / LINE_SIZE];
+
+static unsigned long rand_state = 1;
+
+static unsigned long next_rand(void)
+{
+	rand_state = rand_state * 6364136223846793005UL + 1442695040888963407UL;
+	return rand_state >> 33;
+}
+
+// Sattolo's algorithm, which gives a single cycle through every line
+static struct line *build_ring(unsigned long n)
+{
+	unsigned long i, j, tmp;
+
+	for (i = 0; i < n; i++)
+		order[i] = i;
+
+	for (i = n - 1; i > 0; i--) {
+		j = next_rand() % i;
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	for (i = 0; i < n; i++)
+		lines[i].next = &lines[order[i]];
+
+	return &lines[0];
+}
+
+static struct line *__attribute__((noinline)) chase(
+		struct line *p, unsigned long loads)
+{
+	while (loads >= 4) {
+		p = p->next;
+		p = p->next;
+		p = p->next;
+		p = p->next;
+		loads -= 4;
+	}
+	return p;
+}
+
+int main(void)
+{
+	unsigned long size, n, loads, start, cycles;
+	struct line *p;
+
+	printf("memlat,size,loads,cycles,cycles_per_load_x100\n");
+
+	for (size = MIN_SIZE; size <= MEMLAT_MAX_SIZE; size <<= 1) {
+		n = size / LINE_SIZE;
+		loads = (n < MIN_LOADS) ? MIN_LOADS : n;
+
+		p = build_ring(n);
+		// One lap to warm up whatever fits
+		p = chase(p, n);
+
+		start = rdcycle();
+		p = chase(p, loads);
+		cycles = rdcycle() - start;
+
+		printf("memlat,%lu,%lu,%lu,%lu\n",
+			size, loads, cycles, cycles * 100 / loads);
+	}
+
+	// Keep the chase from being optimized away
+	return p == NULL;
+}
@@ -0,0 +1,266 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "blkdev.h"
+#include "encoding.h"
+#include "mmio.h"
+#include "nic.h"
+
+// Cost of MMIO accesses to the PWM, block device and IceNIC registers,
+// through the periphery bus and its fragmenters. Runs on any config;
+// devices that are not present are found by probing and skipped.
+// MMIOBenchConfig has all three.
+//
+// Only registers without side effects on access are used. For each one,
+// at 8, 16, 32 and 64 bits:
+//   load-latency:     each load's address depends on the previous load
+//   load-throughput:  back-to-back independent loads
+//   load-fence:       a fence before every load
+//   store-throughput: back-to-back stores, then one fence to drain them
+//   store-fence:      a fence after every store, so each waits for its ack
+// The "mixed" rows alternate loads between every device present, to show
+// what switching targets on the bus costs over staying on one.
+//
+// Results are CSV rows prefixed with "mmio-bench", the first of which
+// holds the column names. Cycles per access are printed times 100.
+
+#define NACCESSES 256
+
+#define CAUSE_LOAD_ACCESS 5
+
+#define PWM_BASE 0x2000
+#define PWM_PERIOD (PWM_BASE + 0)
+#define PWM_ENABLE (PWM_BASE + 8)
+
+enum op {
+	LOAD_LATENCY, LOAD_THROUGHPUT, LOAD_FENCE,
+	STORE_THROUGHPUT, STORE_FENCE, NOPS
+};
+
+static const char *op_names[] = {
+	"load-latency", "load-throughput", "load-fence",
+	"store-throughput", "store-fence"
+};
+
+struct mmio_device {
+	const char *name;
+	uintptr_t probe;
+	// Loaded from at every width
+	const char *load_name;
+	uintptr_t load_addr;
+	// Stored to at every width, with zeros. A 64-bit store may also
+	// cover the register above it, which must be harmless to clear.
+	const char *store_name;
+	uintptr_t store_addr;
+	int present;
+};
+
+static struct mmio_device devices[] = {
+	// Period and duty; the PWM stays disabled
+	{ "pwm", PWM_PERIOD, "period", PWM_PERIOD, "period", PWM_PERIOD },
+	// Address of the next request, which is never sent
+	{ "blkdev", BLKDEV_NSECTORS, "addr", BLKDEV_ADDR, "addr", BLKDEV_ADDR },
+	// Interrupts stay masked; nothing is mapped above the mask
+	{ "icenet", SIMPLENIC_COUNTS, "macaddr", SIMPLENIC_MACADDR,
+		"intmask", SIMPLENIC_INTMASK },
+};
+#define NDEVICES (sizeof(devices) / sizeof(devices[0]))
+
+static const int widths[] = { 8, 16, 32, 64 };
+#define NWIDTHS (sizeof(widths) / sizeof(widths[0]))
+
+static volatile int probing, probe_faulted;
+
+uintptr_t handle_trap(uintptr_t cause, uintptr_t epc, uintptr_t regs[32])
+{
+	// The probe load is always a 4-byte instruction
+	if (probing && cause == CAUSE_LOAD_ACCESS) {
+		probe_faulted = 1;
+		return epc + 4;
+	}
+
+	printf("Unexpected trap %lx at %lx\n", cause, epc);
+	exit(1337);
+}
+
+static int probe(uintptr_t addr)
+{
+	unsigned long val;
+
+	probing = 1;
+	probe_faulted = 0;
+	asm volatile (
+		".option push\n"
+		".option norvc\n"
+		"lw %0, 0(%1)\n"
+		".option pop\n"
+		: "=r" (val) : "r" (addr) : "memory");
+	probing = 0;
+	(void) val;
+
+	return !probe_faulted;
+}
+
+// Gives back zero that the core cannot know is zero until v arrives
+static inline uintptr_t depend(unsigned long v)
+{
+	uintptr_t zero;
+
+	asm volatile ("andi %0, %1, 0" : "=r" (zero) : "r" (v));
+	return zero;
+}
+
+static inline unsigned long mmio_load(uintptr_t addr, int width)
+{
+	switch (width) {
+	case 8:
+		return reg_read8(addr);
+	case 16:
+		return reg_read16(addr);
+	case 32:
+		return reg_read32(addr);
+	default:
+		return reg_read64(addr);
+	}
+}
+
+static inline void mmio_store(uintptr_t addr, int width)
+{
+	switch (width) {
+	case 8:
+		reg_write8(addr, 0);
+		break;
+	case 16:
+		reg_write16(addr, 0);
+		break;
+	case 32:
+		reg_write32(addr, 0);
+		break;
+	default:
+		reg_write64(addr, 0);
+		break;
+	}
+}
+
+volatile unsigned long sink_out;
+
+static unsigned long __attribute__((noinline)) run_op(
+		uintptr_t load_addr, uintptr_t store_addr, int width, enum op op)
+{
+	unsigned long start, cycles, sink = 0, v = 0;
+	int i;
+
+	asm volatile ("fence");
+	start = rdcycle();
+
+	for (i = 0; i < NACCESSES; i++) {
+		switch (op) {
+		case LOAD_LATENCY:
+			v = mmio_load(load_addr + depend(v), width);
+			break;
+		case LOAD_THROUGHPUT:
+			sink += mmio_load(load_addr, width);
+			break;
+		case LOAD_FENCE:
+			asm volatile ("fence");
+			sink += mmio_load(load_addr, width);
+			break;
+		case STORE_THROUGHPUT:
+			mmio_store(store_addr, width);
+			break;
+		case STORE_FENCE:
+			mmio_store(store_addr, width);
+			asm volatile ("fence");
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Wait for the last access, whatever it was
+	sink += depend(v + sink);
+	asm volatile ("fence");
+	cycles = rdcycle() - start;
+
+	sink_out = sink;
+
+	return cycles;
+}
+
+static unsigned long __attribute__((noinline)) run_mixed(int width)
+{
+	uintptr_t addrs[NDEVICES];
+	unsigned long start, cycles, sink = 0;
+	int i, n = 0;
+
+	for (i = 0; i < NDEVICES; i++) {
+		if (devices[i].present)
+			addrs[n++] = devices[i].load_addr;
+	}
+
+	asm volatile ("fence");
+	start = rdcycle();
+	for (i = 0; i < NACCESSES; i++)
+		sink += mmio_load(addrs[i % n], width);
+	sink += depend(sink);
+	asm volatile ("fence");
+	cycles = rdcycle() - start;
+
+	sink_out = sink;
+
+	return cycles;
+}
+
+static void print_row(const char *device, const char *reg,
+		int width, const char *op, unsigned long cycles)
+{
+	printf("mmio-bench,%s,%s,%d,%s,%d,%lu,%lu\n",
+		device, reg, width, op, NACCESSES, cycles,
+		cycles * 100 / NACCESSES);
+}
+
+int main(void)
+{
+	struct mmio_device *dev;
+	unsigned long cycles;
+	int i, w, op, npresent = 0;
+
+	printf("mmio-info,device,present\n");
+	for (i = 0; i < NDEVICES; i++) {
+		dev = &devices[i];
+		dev->present = probe(dev->probe);
+		npresent += dev->present;
+		printf("mmio-info,%s,%d\n", dev->name, dev->present);
+	}
+
+	printf("mmio-bench,device,register,width,op,accesses,cycles,"
+		"cycles_per_access_x100\n");
+
+	for (i = 0; i < NDEVICES; i++) {
+		dev = &devices[i];
+		if (!dev->present)
+			continue;
+
+		if (dev->probe == PWM_PERIOD)
+			reg_write32(PWM_ENABLE, 0);
+
+		for (w = 0; w < NWIDTHS; w++) {
+			for (op = 0; op < NOPS; op++) {
+				cycles = run_op(dev->load_addr,
+					dev->store_addr, widths[w], op);
+				print_row(dev->name, op < STORE_THROUGHPUT ?
+						dev->load_name : dev->store_name,
+					widths[w], op_names[op], cycles);
+			}
+		}
+	}
+
+	if (npresent > 1) {
+		for (w = 0; w < NWIDTHS; w++)
+			print_row("mixed", "all", widths[w],
+				"load-throughput", run_mixed(widths[w]));
+	}
+
+	return 0;
+}
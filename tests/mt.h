@@ -0,0 +1,33 @@
+#ifndef __MT_H__
+#define __MT_H__
+
+// Helpers for programs that run on several harts. Build them with
+// -DNCORES=n and link them against crt-mt-<n>c.o (see the Makefile), then
+// override thread_entry(): it runs on every hart, and returning from it on
+// hart 0 goes on to main().
+
+#ifndef NCORES
+#define NCORES 1
+#endif
+
+static volatile int mt_barrier_count;
+static volatile int mt_barrier_sense;
+static __thread int mt_local_sense;
+
+// Sense-reversing barrier across the first n harts
+static void mt_barrier(int n)
+{
+	mt_local_sense = !mt_local_sense;
+
+	if (__sync_fetch_and_add(&mt_barrier_count, 1) == n - 1) {
+		mt_barrier_count = 0;
+		__sync_synchronize();
+		mt_barrier_sense = mt_local_sense;
+	} else {
+		while (mt_barrier_sense != mt_local_sense)
+			;
+	}
+	__sync_synchronize();
+}
+
+#endif
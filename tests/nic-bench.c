@@ -0,0 +1,232 @@
+#include "mmio.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nic.h"
+#include "encoding.h"
+
+// Parameterized NIC benchmark for LoopbackNICConfig.
+//
+// The throughput sweep keeps up to "depth" packets in flight and varies
+// packet size, depth and the alignment of the send buffer. The
+// backpressure test posts bursts of sends with no receive buffers ready
+// and counts how many packets the NIC manages to hold on to, which finds
+// the point where its input buffer (inBufPackets) overflows.
+//
+// Results are printed as CSV rows. Each row starts with its table name,
+// and the first row of each table holds the column names.
+
+#define NPACKETS 64
+#define MAX_PACKET_LEN 1520
+#define MAX_ALIGN 8
+#define BUF_WORDS ((MAX_PACKET_LEN + MAX_ALIGN) / sizeof(uint64_t))
+#define MAX_DEPTH 32
+#define MAX_BURST 32
+// Give up on more packets arriving after this many idle cycles
+#define DRAIN_TIMEOUT 20000
+
+static const int sizes[] = {64, 128, 256, 512, 1024, MAX_PACKET_LEN};
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static const int depths[] = {1, 2, 4, 8, 16, MAX_DEPTH};
+#define NDEPTHS (sizeof(depths) / sizeof(depths[0]))
+
+static const int aligns[] = {0, 2, 4};
+#define NALIGNS (sizeof(aligns) / sizeof(aligns[0]))
+
+uint64_t src[MAX_DEPTH][BUF_WORDS];
+uint64_t dst[MAX_BURST][BUF_WORDS];
+unsigned long post_cycle[MAX_DEPTH];
+unsigned long latency[NPACKETS];
+
+static void sort(unsigned long *data, int n)
+{
+	for (int i = 1; i < n; i++) {
+		unsigned long key = data[i];
+		int j = i - 1;
+		while (j >= 0 && data[j] > key) {
+			data[j + 1] = data[j];
+			j--;
+		}
+		data[j + 1] = key;
+	}
+}
+
+static inline unsigned long percentile(unsigned long *sorted, int n, int pct)
+{
+	return sorted[(n - 1) * pct / 100];
+}
+
+// Keep depth packets in flight until NPACKETS have looped back. Sends and
+// receives complete in order, so packet i always uses slot i % depth.
+static void run_throughput(int size, int depth, int align)
+{
+	int sent = 0, recvd = 0, send_done = 0;
+	unsigned long start, cycles;
+	uint32_t counts;
+
+	start = rdcycle();
+
+	while (recvd < NPACKETS) {
+		int n, i;
+
+		counts = nic_counts();
+
+		n = NIC_SEND_COMP_AVAIL(counts);
+		for (i = 0; i < n; i++)
+			reg_read16(SIMPLENIC_SEND_COMP);
+		send_done += n;
+
+		n = NIC_RECV_COMP_AVAIL(counts);
+		for (i = 0; i < n; i++) {
+			int len = reg_read16(SIMPLENIC_RECV_COMP);
+			if (len != size) {
+				printf("recv got wrong # bytes: %d != %d\n",
+						len, size);
+				exit(EXIT_FAILURE);
+			}
+			latency[recvd] = rdcycle() - post_cycle[recvd % depth];
+			recvd++;
+		}
+
+		// The receive buffer for a packet goes in before its send,
+		// so it never has to wait in the NIC's input buffer
+		n = NIC_SEND_REQ_AVAIL(counts);
+		if (NIC_RECV_REQ_AVAIL(counts) < n)
+			n = NIC_RECV_REQ_AVAIL(counts);
+		if (recvd + depth - sent < n)
+			n = recvd + depth - sent;
+		if (NPACKETS - sent < n)
+			n = NPACKETS - sent;
+
+		for (i = 0; i < n; i++) {
+			int slot = sent % depth;
+			nic_post_recv(dst[slot]);
+			post_cycle[slot] = rdcycle();
+			nic_post_send((uint8_t *) src[slot] + align, size);
+			sent++;
+		}
+	}
+
+	while (send_done < NPACKETS) {
+		int n = nic_send_comp_avail();
+		for (int i = 0; i < n; i++)
+			reg_read16(SIMPLENIC_SEND_COMP);
+		send_done += n;
+	}
+
+	cycles = rdcycle() - start;
+	sort(latency, NPACKETS);
+
+	printf("nic-throughput,%d,%d,%d,%d,%lu,%lu,%lu,%lu,%lu\n",
+		size, depth, align, NPACKETS, cycles,
+		(unsigned long) NPACKETS * size * 1000 / cycles,
+		percentile(latency, NPACKETS, 50),
+		percentile(latency, NPACKETS, 90),
+		percentile(latency, NPACKETS, 99));
+}
+
+// Loop back one packet into the receive buffer still posted at the end of
+// a backpressure test, so it does not swallow a packet of the next one
+static void drain_recv_buffer(int size)
+{
+	int sent = 0, recvd = 0;
+
+	nic_post_send(src[0], size);
+	while (!sent || !recvd) {
+		uint32_t counts = nic_counts();
+
+		if (NIC_SEND_COMP_AVAIL(counts)) {
+			reg_read16(SIMPLENIC_SEND_COMP);
+			sent = 1;
+		}
+		if (NIC_RECV_COMP_AVAIL(counts)) {
+			reg_read16(SIMPLENIC_RECV_COMP);
+			recvd = 1;
+		}
+	}
+}
+
+// Post burst sends with no receive buffers, then hand the NIC receive
+// buffers and count how many of the packets it kept
+static int run_backpressure(int burst, int size)
+{
+	int posted = 0, recv_posted = 0, recvd = 0, send_done = 0;
+	unsigned long last_progress;
+
+	while (posted < burst) {
+		int n = nic_send_req_avail();
+		for (int i = 0; i < n && posted < burst; i++, posted++)
+			nic_post_send(src[posted % MAX_DEPTH], size);
+	}
+
+	while (send_done < burst) {
+		int n = nic_send_comp_avail();
+		for (int i = 0; i < n; i++)
+			reg_read16(SIMPLENIC_SEND_COMP);
+		send_done += n;
+	}
+
+	last_progress = rdcycle();
+	while (rdcycle() - last_progress < DRAIN_TIMEOUT) {
+		uint32_t counts = nic_counts();
+		int n = NIC_RECV_COMP_AVAIL(counts);
+
+		for (int i = 0; i < n; i++)
+			reg_read16(SIMPLENIC_RECV_COMP);
+		if (n > 0) {
+			recvd += n;
+			last_progress = rdcycle();
+		}
+
+		// One buffer at a time, so that once the NIC has handed over
+		// every packet it kept, at most one is left unfilled
+		if (recv_posted == recvd && recv_posted < burst &&
+				NIC_RECV_REQ_AVAIL(counts) > 0)
+			nic_post_recv(dst[recv_posted++]);
+	}
+
+	if (recv_posted > recvd)
+		drain_recv_buffer(size);
+
+	printf("nic-backpressure,%d,%d,%d,%d\n",
+			burst, size, recvd, burst - recvd);
+
+	return recvd;
+}
+
+int main(void)
+{
+	uint32_t counts = nic_counts();
+	int i, j, k, knee = 0;
+
+	for (i = 0; i < MAX_DEPTH; i++) {
+		for (j = 0; j < BUF_WORDS; j++)
+			src[i][j] = ((uint64_t) i << 32) | j;
+	}
+
+	printf("nic-info,send_slots,recv_slots\n");
+	printf("nic-info,%d,%d\n",
+		NIC_SEND_REQ_AVAIL(counts), NIC_RECV_REQ_AVAIL(counts));
+
+	printf("nic-throughput,size,depth,align,packets,cycles,"
+		"bytes_per_kcycle,lat_p50,lat_p90,lat_p99\n");
+	for (i = 0; i < NSIZES; i++) {
+		for (j = 0; j < NDEPTHS; j++) {
+			for (k = 0; k < NALIGNS; k++)
+				run_throughput(sizes[i], depths[j], aligns[k]);
+		}
+	}
+
+	printf("nic-backpressure,burst,size,received,dropped\n");
+	for (i = 1; i <= MAX_BURST; i++) {
+		if (run_backpressure(i, MAX_PACKET_LEN) < i && knee == 0)
+			knee = i;
+	}
+
+	printf("nic-knee,first_drop_burst\n");
+	printf("nic-knee,%d\n", knee);
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+#ifndef __NIC_DRIVER_H__
+#define __NIC_DRIVER_H__
+
+// Batched IceNIC driver with a fixed pool of packet buffers.
+//
+// Every buffer lives in exactly one place at a time: the free list, the
+// NIC receive queue, the ready queue (received but not yet consumed), the
+// pending send queue (queued by software, not yet posted), or the NIC send
+// queue. Buffers handed out by nic_driver_recv() can be rewritten in place
+// and passed straight to nic_driver_send(), so a request/reply server never
+// copies packet data. A buffer returns to the free list when its send
+// completes, or when the program calls nic_buf_free().
+//
+// nic_driver_poll() reads the counts register once, drains every available
+// completion, posts as many queued sends as the NIC accepts and refills the
+// receive queue from the free list. The driver remembers how many send
+// slots that read showed, so nic_driver_send() can post a reply straight
+// away, overlapping its transmission with the processing of the rest of
+// the batch, without another counts read.
+
+#include <stdint.h>
+
+#include "mmio.h"
+#include "nic.h"
+#include "encoding.h"
+
+// Large enough for a maximum size frame plus NET_IP_ALIGN padding
+#define NIC_BUF_WORDS 192
+#define NIC_BUF_SIZE (NIC_BUF_WORDS * sizeof(uint64_t))
+// Must be a power of two
+#define NIC_NBUFS 32
+
+struct nic_buf {
+	uint64_t data[NIC_BUF_WORDS];
+} __attribute__((aligned(64)));
+
+struct nic_ring_entry {
+	uint16_t idx;
+	uint16_t len;
+};
+
+// Since the pool has NIC_NBUFS buffers, a ring of the same size never fills
+struct nic_ring {
+	struct nic_ring_entry entries[NIC_NBUFS];
+	unsigned int head;
+	unsigned int tail;
+};
+
+struct nic_driver {
+	struct nic_buf bufs[NIC_NBUFS];
+	uint16_t free_list[NIC_NBUFS];
+	int nfree;
+	struct nic_ring recv_posted;
+	struct nic_ring recv_ready;
+	struct nic_ring send_pending;
+	struct nic_ring send_posted;
+	// Send slots known to be free as of the last poll
+	int send_slots;
+	// rdcycle() at the start of the last poll
+	unsigned long poll_cycle;
+};
+
+static inline int nic_ring_count(struct nic_ring *ring)
+{
+	return ring->tail - ring->head;
+}
+
+static inline void nic_ring_push(struct nic_ring *ring, int idx, int len)
+{
+	struct nic_ring_entry *ent;
+
+	ent = &ring->entries[ring->tail & (NIC_NBUFS - 1)];
+	ent->idx = idx;
+	ent->len = len;
+	ring->tail++;
+}
+
+static inline struct nic_ring_entry *nic_ring_pop(struct nic_ring *ring)
+{
+	struct nic_ring_entry *ent;
+
+	ent = &ring->entries[ring->head & (NIC_NBUFS - 1)];
+	ring->head++;
+	return ent;
+}
+
+static inline void *nic_buf_data(struct nic_driver *drv, int idx)
+{
+	return drv->bufs[idx].data;
+}
+
+static inline int nic_buf_alloc(struct nic_driver *drv)
+{
+	if (drv->nfree == 0)
+		return -1;
+	return drv->free_list[--drv->nfree];
+}
+
+static inline void nic_buf_free(struct nic_driver *drv, int idx)
+{
+	drv->free_list[drv->nfree++] = idx;
+}
+
+// Post queued sends or free receive buffers into at most avail request
+// slots. Both return the number of slots still free afterwards.
+static inline int nic_driver_post_sends(struct nic_driver *drv, int avail)
+{
+	struct nic_ring_entry *ent;
+
+	while (avail > 0 && nic_ring_count(&drv->send_pending) > 0) {
+		ent = nic_ring_pop(&drv->send_pending);
+		nic_post_send(nic_buf_data(drv, ent->idx), ent->len);
+		nic_ring_push(&drv->send_posted, ent->idx, ent->len);
+		avail--;
+	}
+
+	return avail;
+}
+
+static inline int nic_driver_post_recvs(struct nic_driver *drv, int avail)
+{
+	int idx;
+
+	while (avail > 0 && (idx = nic_buf_alloc(drv)) >= 0) {
+		nic_post_recv(nic_buf_data(drv, idx));
+		nic_ring_push(&drv->recv_posted, idx, 0);
+		avail--;
+	}
+
+	return avail;
+}
+
+// One MMIO pass over the NIC. Returns the number of packets received.
+static int nic_driver_poll(struct nic_driver *drv)
+{
+	struct nic_ring_entry *ent;
+	uint32_t counts;
+	int nsend, nrecv, i;
+
+	drv->poll_cycle = rdcycle();
+	counts = nic_counts();
+	nsend = NIC_SEND_COMP_AVAIL(counts);
+	nrecv = NIC_RECV_COMP_AVAIL(counts);
+
+	for (i = 0; i < nsend; i++) {
+		reg_read16(SIMPLENIC_SEND_COMP);
+		ent = nic_ring_pop(&drv->send_posted);
+		nic_buf_free(drv, ent->idx);
+	}
+
+	for (i = 0; i < nrecv; i++) {
+		int len = reg_read16(SIMPLENIC_RECV_COMP);
+		ent = nic_ring_pop(&drv->recv_posted);
+		nic_ring_push(&drv->recv_ready, ent->idx, len);
+	}
+
+	// Make sure the packet data is visible before the program reads it
+	if (nrecv > 0)
+		asm volatile ("fence");
+
+	drv->send_slots = nic_driver_post_sends(drv,
+			NIC_SEND_REQ_AVAIL(counts));
+	nic_driver_post_recvs(drv, NIC_RECV_REQ_AVAIL(counts));
+
+	return nrecv;
+}
+
+static void nic_driver_init(struct nic_driver *drv)
+{
+	int i;
+
+	drv->nfree = 0;
+	for (i = NIC_NBUFS - 1; i >= 0; i--)
+		nic_buf_free(drv, i);
+
+	drv->recv_posted.head = drv->recv_posted.tail = 0;
+	drv->recv_ready.head = drv->recv_ready.tail = 0;
+	drv->send_pending.head = drv->send_pending.tail = 0;
+	drv->send_posted.head = drv->send_posted.tail = 0;
+	drv->send_slots = 0;
+
+	nic_driver_post_recvs(drv, nic_recv_req_avail());
+}
+
+// Take the next received packet. Returns its buffer index and sets *len,
+// or returns -1 if nothing has arrived since the last poll.
+static inline int nic_driver_recv(struct nic_driver *drv, int *len)
+{
+	struct nic_ring_entry *ent;
+
+	if (nic_ring_count(&drv->recv_ready) == 0)
+		return -1;
+
+	ent = nic_ring_pop(&drv->recv_ready);
+	*len = ent->len;
+	return ent->idx;
+}
+
+// Send a buffer. It is posted immediately if the last poll saw a free send
+// slot, otherwise it waits for the next poll. The buffer returns to the
+// free list once the NIC has sent it.
+static inline void nic_driver_send(struct nic_driver *drv, int idx, int len)
+{
+	// Nothing can be pending while slots are left, so order is kept
+	if (drv->send_slots > 0) {
+		nic_post_send(nic_buf_data(drv, idx), len);
+		nic_ring_push(&drv->send_posted, idx, len);
+		drv->send_slots--;
+	} else {
+		nic_ring_push(&drv->send_pending, idx, len);
+	}
+}
+
+static inline int nic_driver_sends_outstanding(struct nic_driver *drv)
+{
+	return nic_ring_count(&drv->send_pending) +
+		nic_ring_count(&drv->send_posted);
+}
+
+#endif
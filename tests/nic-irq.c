@@ -0,0 +1,87 @@
+#include "mmio.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nic-irq.h"
+#include "encoding.h"
+
+// Light load on the loopback NIC: one packet in flight at a time, so the
+// receiver spends most of its time waiting. Each poll budget is run over
+// the same traffic and we report how much of the waiting the core spent
+// asleep instead of polling the NIC over the periphery bus.
+
+#define NPACKETS 32
+#define PACKET_LEN 1024
+
+static const int budgets[] = {0, 256, 64, 16, 1};
+#define NBUDGETS (sizeof(budgets) / sizeof(budgets[0]))
+
+struct nic_driver nicdrv;
+
+uintptr_t handle_interrupt(uintptr_t cause, uintptr_t epc, uintptr_t regs[32])
+{
+	if (!nic_irq_handle(cause))
+		exit(1337);
+	return epc;
+}
+
+static void run_budget(int budget)
+{
+	unsigned long start_cycle, start_instret, cycles, instret;
+	int i, idx, len;
+
+	nic_poll_budget = budget;
+	memset(&nic_irq_stats, 0, sizeof(nic_irq_stats));
+
+	start_cycle = rdcycle();
+	start_instret = rdinstret();
+
+	for (i = 0; i < NPACKETS; i++) {
+		idx = nic_buf_alloc(&nicdrv);
+		if (idx < 0) {
+			printf("Ran out of packet buffers\n");
+			exit(EXIT_FAILURE);
+		}
+		memset(nic_buf_data(&nicdrv, idx), i, PACKET_LEN);
+		nic_driver_send(&nicdrv, idx, PACKET_LEN);
+
+		nic_driver_wait_recv(&nicdrv);
+		idx = nic_driver_recv(&nicdrv, &len);
+		if (len != PACKET_LEN) {
+			printf("recv got wrong # bytes: %d\n", len);
+			exit(EXIT_FAILURE);
+		}
+		if (*(uint8_t *) nic_buf_data(&nicdrv, idx) != (uint8_t) i) {
+			printf("Data mismatch in packet %d\n", i);
+			exit(EXIT_FAILURE);
+		}
+		nic_buf_free(&nicdrv, idx);
+	}
+
+	nic_driver_wait_sends(&nicdrv);
+
+	cycles = rdcycle() - start_cycle;
+	instret = rdinstret() - start_instret;
+
+	printf("budget %d: %lu cycles, %lu cycles/packet, %lu instret, "
+		"%lu polls, %lu interrupts, %lu cycles asleep (%lu%%)\n",
+		budget, cycles, cycles / NPACKETS, instret,
+		nic_irq_stats.polls, nic_irq_stats.interrupts,
+		nic_irq_stats.sleep_cycles,
+		nic_irq_stats.sleep_cycles * 100 / cycles);
+}
+
+int main(void)
+{
+	nic_driver_init(&nicdrv);
+	nic_irq_init();
+
+	// Budget 0 is pure polling, budget 1 sleeps after every empty poll
+	for (int i = 0; i < NBUDGETS; i++)
+		run_budget(budgets[i]);
+
+	printf("All correct\n");
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+#ifndef __NIC_IRQ_H__
+#define __NIC_IRQ_H__
+
+// Interrupt-driven waiting for the IceNIC driver.
+//
+// The waits are NAPI-style hybrids. While packets keep arriving the driver
+// stays in polling mode, so a busy server never pays for an interrupt.
+// Once nic_poll_budget polls in a row find nothing, the core unmasks the
+// NIC interrupt and sleeps in wfi. A budget of zero disables sleeping and
+// gives the old pure polling behaviour. The interrupt handler masks the NIC
+// interrupt again before returning, and the driver goes back to polling.
+//
+// The NIC interrupt is routed through the PLIC. TestHarness ties off the
+// external interrupt lines, so in the NIC configs any claimed PLIC source
+// is the NIC and the driver does not need to know its source number.
+//
+// Programs using these waits must call nic_irq_init() and forward machine
+// external interrupts from handle_interrupt() to nic_irq_handle().
+
+#include "encoding.h"
+#include "nic-driver.h"
+#include "plic.h"
+
+#ifndef NIC_POLL_BUDGET
+#define NIC_POLL_BUDGET 64
+#endif
+
+struct nic_irq_stats {
+	unsigned long interrupts;
+	unsigned long sleeps;
+	unsigned long sleep_cycles;
+	unsigned long polls;
+};
+
+static int nic_poll_budget = NIC_POLL_BUDGET;
+static volatile int nic_irq_fired;
+static struct nic_irq_stats nic_irq_stats;
+
+static void nic_irq_init(void)
+{
+	nic_set_intmask(0);
+	plic_enable_all(0);
+	set_csr(mie, MIP_MEIP);
+}
+
+// Call from handle_interrupt(). Returns nonzero if the interrupt was ours.
+static int nic_irq_handle(uintptr_t cause)
+{
+	int id;
+
+	if (cause != IRQ_M_EXT)
+		return 0;
+
+	id = plic_claim(0);
+	// Level-triggered, so mask before completing or it fires again
+	nic_set_intmask(0);
+	plic_complete(0, id);
+
+	nic_irq_stats.interrupts++;
+	nic_irq_fired = 1;
+
+	return 1;
+}
+
+// Sleep until one of the completion queues in mask is non-empty. If a
+// completion is already waiting the interrupt is taken immediately, so
+// there is no window in which a wakeup can be lost.
+static void nic_irq_sleep(uint32_t mask)
+{
+	unsigned long start = rdcycle();
+
+	nic_irq_fired = 0;
+	clear_csr(mstatus, MSTATUS_MIE);
+	nic_set_intmask(mask);
+
+	while (!nic_irq_fired) {
+		// wfi wakes on a pending interrupt even with MIE clear.
+		// Setting MIE then takes the trap, and nic_irq_handle()
+		// records it before we test the flag again.
+		asm volatile ("wfi");
+		set_csr(mstatus, MSTATUS_MIE);
+		clear_csr(mstatus, MSTATUS_MIE);
+	}
+
+	nic_irq_stats.sleeps++;
+	nic_irq_stats.sleep_cycles += rdcycle() - start;
+}
+
+// Wait until at least one received packet is ready in the driver. Sends
+// still queued for lack of a free slot also wake it, so they get posted
+// as soon as a slot frees up rather than when the next packet arrives.
+static void nic_driver_wait_recv(struct nic_driver *drv)
+{
+	int budget = nic_poll_budget;
+
+	while (nic_ring_count(&drv->recv_ready) == 0) {
+		uint32_t mask = NIC_INTMASK_RECV;
+
+		nic_irq_stats.polls++;
+		if (nic_driver_poll(drv) > 0)
+			break;
+		if (nic_poll_budget == 0 || --budget > 0)
+			continue;
+
+		if (nic_ring_count(&drv->send_pending) > 0)
+			mask |= NIC_INTMASK_SEND;
+		nic_irq_sleep(mask);
+		budget = nic_poll_budget;
+	}
+}
+
+// Wait until every queued send has completed and its buffer is free
+static inline void nic_driver_wait_sends(struct nic_driver *drv)
+{
+	int budget = nic_poll_budget;
+
+	for (;;) {
+		nic_irq_stats.polls++;
+		nic_driver_poll(drv);
+		if (nic_driver_sends_outstanding(drv) == 0)
+			break;
+		if (nic_poll_budget == 0 || --budget > 0)
+			continue;
+
+		nic_irq_sleep(NIC_INTMASK_SEND);
+		budget = nic_poll_budget;
+	}
+}
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "nic.h"
 #include "encoding.h"
+#include "perf-region.h"
 
 #define NPACKETS 10
 #define TEST_OFFSET 3
@@ -12,6 +13,10 @@
 #define ARRAY_LEN 360
 #define NTRIALS 3
 
+// Regions for the simulator's +topdown breakdown
+#define REGION_POST 1
+#define REGION_POLL 2
+
 uint32_t src[NPACKETS][ARRAY_LEN];
 uint32_t dst[NPACKETS][ARRAY_LEN];
 uint64_t lengths[NPACKETS];
@@ -22,6 +27,7 @@ static inline void send_recv()
 	int ncomps, send_comps_left = NPACKETS, recv_comps_left = NPACKETS;
 	int recv_idx = 0;
 
+	PERF_REGION_BEGIN(REGION_POST);
 	for (int i = 0; i < NPACKETS; i++) {
 		uint64_t pkt_size = TEST_LEN * sizeof(uint32_t);
 		uint64_t src_addr = (uint64_t) &src[i][TEST_OFFSET];
@@ -30,7 +36,9 @@ static inline void send_recv()
 		reg_write64(SIMPLENIC_SEND_REQ, send_packet);
 		reg_write64(SIMPLENIC_RECV_REQ, recv_addr);
 	}
+	PERF_REGION_END();
 
+	PERF_REGION_BEGIN(REGION_POLL);
 	while (send_comps_left > 0 || recv_comps_left > 0) {
 		ncomps = nic_send_comp_avail();
 		asm volatile ("fence");
@@ -46,6 +54,7 @@ static inline void send_recv()
 		}
 		recv_comps_left -= ncomps;
 	}
+	PERF_REGION_END();
 }
 
 void run_test(void)
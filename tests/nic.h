@@ -1,3 +1,6 @@
+#ifndef __NIC_H__
+#define __NIC_H__
+
 #define SIMPLENIC_BASE 0x10016000L
 #define SIMPLENIC_SEND_REQ (SIMPLENIC_BASE + 0)
 #define SIMPLENIC_RECV_REQ (SIMPLENIC_BASE + 8)
@@ -5,6 +8,12 @@
 #define SIMPLENIC_RECV_COMP (SIMPLENIC_BASE + 18)
 #define SIMPLENIC_COUNTS (SIMPLENIC_BASE + 20)
 #define SIMPLENIC_MACADDR (SIMPLENIC_BASE + 24)
+#define SIMPLENIC_INTMASK (SIMPLENIC_BASE + 32)
+
+// The NIC holds its interrupt high while a completion queue selected by
+// the mask is non-empty
+#define NIC_INTMASK_SEND 1
+#define NIC_INTMASK_RECV 2
 
 static inline int nic_send_req_avail(void)
 {
@@ -26,25 +35,50 @@ static inline int nic_recv_comp_avail(void)
 	return (reg_read32(SIMPLENIC_COUNTS) >> 24) & 0xff;
 }
 
-static void nic_send(void *data, unsigned long len)
+// A single read of the counts register returns all four queue counts.
+// Drivers that service several queues per pass should read it once with
+// nic_counts() and decode the fields, rather than issue one MMIO read
+// per queue.
+#define NIC_SEND_REQ_AVAIL(counts) ((counts) & 0xff)
+#define NIC_RECV_REQ_AVAIL(counts) (((counts) >> 8) & 0xff)
+#define NIC_SEND_COMP_AVAIL(counts) (((counts) >> 16) & 0xff)
+#define NIC_RECV_COMP_AVAIL(counts) (((counts) >> 24) & 0xff)
+
+static inline uint32_t nic_counts(void)
+{
+	return reg_read32(SIMPLENIC_COUNTS);
+}
+
+// Post a send request without waiting for a free slot or the completion
+static inline void nic_post_send(void *data, unsigned long len)
 {
 	uintptr_t addr = ((uintptr_t) data) & ((1L << 48) - 1);
 	unsigned long packet = (len << 48) | addr;
 
-	while (nic_send_req_avail() == 0);
 	reg_write64(SIMPLENIC_SEND_REQ, packet);
+}
+
+// Post a receive buffer without waiting for a free slot or the completion
+static inline void nic_post_recv(void *dest)
+{
+	reg_write64(SIMPLENIC_RECV_REQ, (uintptr_t) dest);
+}
+
+static inline void nic_send(void *data, unsigned long len)
+{
+	while (nic_send_req_avail() == 0);
+	nic_post_send(data, len);
 
 	while (nic_send_comp_avail() == 0);
 	reg_read16(SIMPLENIC_SEND_COMP);
 }
 
-static int nic_recv(void *dest)
+static inline int nic_recv(void *dest)
 {
-	uintptr_t addr = (uintptr_t) dest;
 	int len;
 
 	while (nic_recv_req_avail() == 0);
-	reg_write64(SIMPLENIC_RECV_REQ, addr);
+	nic_post_recv(dest);
 
 	// Poll for completion
 	while (nic_recv_comp_avail() == 0);
@@ -54,7 +88,14 @@ static int nic_recv(void *dest)
 	return len;
 }
 
+static inline void nic_set_intmask(uint32_t mask)
+{
+	reg_write32(SIMPLENIC_INTMASK, mask);
+}
+
 static inline uint64_t nic_macaddr(void)
 {
 	return reg_read64(SIMPLENIC_MACADDR);
 }
+
+#endif
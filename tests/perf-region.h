@@ -0,0 +1,18 @@
+#ifndef __PERF_REGION_H__
+#define __PERF_REGION_H__
+
+// Marks code regions for the Verilator simulator's +topdown cycle
+// breakdown. Each marker is a "slti x0, x0, id", which does nothing on
+// the core and on spike but which the simulator sees retire, so they can
+// be left in benchmarks.
+//
+// Regions nest: cycles go to the innermost open region, and cycles outside
+// any region go to region 0. ids run from 1 to 2047 and must be constants.
+
+#define PERF_REGION_BEGIN(id) \
+	asm volatile ("slti x0, x0, %0" :: "i"(id) : "memory")
+
+#define PERF_REGION_END() \
+	asm volatile ("slti x0, x0, 0" ::: "memory")
+
+#endif
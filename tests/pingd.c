@@ -1,5 +1,7 @@
 #include "mmio.h"
-#include "nic.h"
+#include "nic-irq.h"
+#include "checksum.h"
+#include "encoding.h"
 
 #include <stdint.h>
 #include <stdlib.h>
@@ -70,23 +72,63 @@ struct icmp_header {
 	uint32_t rest;
 };
 
-static int checksum(uint16_t *data, int len)
-{
-	int i;
-	uint32_t sum = 0;
-
-	for (i = 0; i < len; i++)
-		sum += ntohs(data[i]);
+#define ceil_div(n, d) (((n) - 1) / (d) + 1)
 
-	while ((sum >> 16) != 0)
-		sum = (sum & 0xffff) + (sum >> 16);
+// Print throughput and latency every this many packets
+#ifndef PINGD_REPORT_INTERVAL
+#define PINGD_REPORT_INTERVAL 1000
+#endif
+
+// Only used to turn cycles into packets per second
+#ifndef PINGD_CLOCK_MHZ
+#define PINGD_CLOCK_MHZ 1000
+#endif
+
+// Latency is measured from the poll that picked up a request to the
+// point where its reply is handed to the driver
+struct pingd_stats {
+	unsigned long start_cycle;
+	unsigned long packets;
+	unsigned long batches;
+	unsigned long lat_total;
+	unsigned long lat_min;
+	unsigned long lat_max;
+};
 
-	sum = ~sum & 0xffff;
+static void stats_reset(struct pingd_stats *stats)
+{
+	stats->start_cycle = rdcycle();
+	stats->packets = 0;
+	stats->batches = 0;
+	stats->lat_total = 0;
+	stats->lat_min = -1L;
+	stats->lat_max = 0;
+}
 
-	return sum;
+static void stats_report(struct pingd_stats *stats)
+{
+	unsigned long cycles = rdcycle() - stats->start_cycle;
+
+	printf("pingd: %lu packets in %lu cycles, %lu batches, "
+		"%lu packets/Mcycle, %lu pps at %d MHz, "
+		"latency min %lu avg %lu max %lu cycles\n",
+		stats->packets, cycles, stats->batches,
+		stats->packets * 1000000 / cycles,
+		stats->packets * PINGD_CLOCK_MHZ * 1000000 / cycles,
+		PINGD_CLOCK_MHZ,
+		stats->lat_min, stats->lat_total / stats->packets,
+		stats->lat_max);
 }
 
-#define ceil_div(n, d) (((n) - 1) / (d) + 1)
+static inline void stats_record(struct pingd_stats *stats, unsigned long lat)
+{
+	stats->packets++;
+	stats->lat_total += lat;
+	if (lat < stats->lat_min)
+		stats->lat_min = lat;
+	if (lat > stats->lat_max)
+		stats->lat_max = lat;
+}
 
 static int process_arp(void *buf, uint8_t *mac)
 {
@@ -138,11 +180,9 @@ static int process_arp(void *buf, uint8_t *mac)
 	memcpy(arp->tpa, arp->spa, IP_ADDR_SIZE);
 	memcpy(arp->spa, tmp_addr, IP_ADDR_SIZE);
 
-	size = ceil_div(size + NET_IP_ALIGN, 8) * 8;
-	nic_send(buf, size);
-
-	return 0;
+	return ceil_div(size + NET_IP_ALIGN, 8) * 8;
 }
+
 static int process_icmp(void *buf, uint8_t *mac)
 {
 	struct eth_header *eth = buf;
@@ -151,12 +191,13 @@ static int process_icmp(void *buf, uint8_t *mac)
 	int ihl, icmp_size;
 	ssize_t size;
 	uint32_t tmp_addr;
+	uint16_t old_type;
 
 	// verify IPv4
 	ipv4 = buf + sizeof(*eth);
 	ihl = ipv4->ver_ihl & 0xf;
 
-	if (checksum((uint16_t *) ipv4, ihl << 1) != 0) {
+	if (csum(ipv4, ihl << 2) != 0) {
 		printf("Bad IP header checksum %04x\n", ipv4->cksum);
 		return -1;
 	}
@@ -180,7 +221,7 @@ static int process_icmp(void *buf, uint8_t *mac)
 	}
 
 	icmp_size = ntohs(ipv4->length) - (ihl << 2);
-	if (checksum((uint16_t *) icmp, icmp_size >> 1) != 0) {
+	if (csum(icmp, icmp_size) != 0) {
 		printf("Bad ICMP checksum %04x\n", icmp->cksum);
 		return -1;
 	}
@@ -189,35 +230,30 @@ static int process_icmp(void *buf, uint8_t *mac)
 	memcpy(eth->dst_mac, eth->src_mac, MAC_ADDR_SIZE);
 	memcpy(eth->src_mac, mac, MAC_ADDR_SIZE);
 
-	// Swap the source and destination IP addresses
+	// Swap the source and destination IP addresses. This only reorders
+	// 16-bit words of the header, so the IPv4 checksum stays valid.
 	tmp_addr = ipv4->dst_addr;
 	ipv4->dst_addr = ipv4->src_addr;
 	ipv4->src_addr = tmp_addr;
 
-	// compute the IPv4 header checksum
-	ipv4->cksum = 0;
-	ipv4->cksum = htons(checksum((uint16_t *) ipv4, ihl << 1));
-
-	// set the ICMP type to reply and compute checksum
-	icmp->cksum = 0;
+	// set the ICMP type to reply and patch the checksum for the
+	// changed type/code word instead of summing the payload again
+	old_type = *(uint16_t *) icmp;
 	icmp->type = ECHO_REPLY;
-	icmp->cksum = htons(checksum((uint16_t *) icmp, icmp_size >> 1));
+	icmp->cksum = csum_replace2(icmp->cksum, old_type, *(uint16_t *) icmp);
 	size = ntohs(ipv4->length) + ETH_HEADER_SIZE;
 
-	size = ceil_div(size + NET_IP_ALIGN, 8) * 8;
-	nic_send(buf, size);
-
-	return 0;
+	return ceil_div(size + NET_IP_ALIGN, 8) * 8;
 }
 
+// Returns the length of the reply, which has been written in place
 static int process_packet(void *buf, uint8_t *mac)
 {
-	struct eth_header *eth;
+	struct eth_header *eth = buf;
 
-	// read the ICMP request
-	nic_recv(buf);
-	eth = buf;
+#ifdef PINGD_VERBOSE
 	printf("Got packet: [ethtype=%04x]\n", ntohs(eth->ethtype));
+#endif
 	// Check ethernet type
 	switch (ntohs(eth->ethtype)) {
 	case IPV4_ETHTYPE:
@@ -230,12 +266,21 @@ static int process_packet(void *buf, uint8_t *mac)
 	}
 }
 
-uint64_t buffer[ETH_MAX_WORDS];
+struct nic_driver nicdrv;
+struct pingd_stats stats;
+
+uintptr_t handle_interrupt(uintptr_t cause, uintptr_t epc, uintptr_t regs[32])
+{
+	if (!nic_irq_handle(cause))
+		exit(1337);
+	return epc;
+}
 
 int main(void)
 {
 	uint64_t macaddr_long;
 	uint8_t *macaddr;
+	int idx, len;
 
 	macaddr_long = nic_macaddr();
 	macaddr = (uint8_t *) &macaddr_long;
@@ -245,9 +290,34 @@ int main(void)
 		printf(":%02x", macaddr[i]);
 	printf("\n");
 
+	nic_driver_init(&nicdrv);
+	nic_irq_init();
+	stats_reset(&stats);
+
 	for (;;) {
-		if (process_packet(buffer, macaddr))
-			return -1;
+		// Polls while requests keep coming, sleeps when idle. Every
+		// poll also tops up the NIC's receive request queue from the
+		// buffer pool, so a burst can fill as many buffers as that
+		// queue holds, on top of the NIC's own input buffer.
+		nic_driver_wait_recv(&nicdrv);
+		stats.batches++;
+
+		// Handle the whole batch the poll picked up. Replies go out
+		// of the buffer the request arrived in and are posted as
+		// soon as they are ready, so the NIC sends earlier replies
+		// while later requests are parsed.
+		while ((idx = nic_driver_recv(&nicdrv, &len)) >= 0) {
+			len = process_packet(nic_buf_data(&nicdrv, idx), macaddr);
+			if (len < 0)
+				return -1;
+			nic_driver_send(&nicdrv, idx, len);
+			stats_record(&stats, rdcycle() - nicdrv.poll_cycle);
+		}
+
+		if (stats.packets >= PINGD_REPORT_INTERVAL) {
+			stats_report(&stats);
+			stats_reset(&stats);
+		}
 	}
 
 	return 0;
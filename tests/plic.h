@@ -0,0 +1,36 @@
+#ifndef __PLIC_H__
+#define __PLIC_H__
+
+#include "mmio.h"
+
+// Platform-level interrupt controller. Context 0 is hart 0 in M-mode.
+#define PLIC_BASE 0x0C000000L
+#define PLIC_PRIORITY(id) (PLIC_BASE + 4 * (id))
+#define PLIC_PENDING (PLIC_BASE + 0x1000)
+#define PLIC_ENABLE(ctx) (PLIC_BASE + 0x2000 + 0x80 * (ctx))
+#define PLIC_THRESHOLD(ctx) (PLIC_BASE + 0x200000 + 0x1000 * (ctx))
+#define PLIC_CLAIM(ctx) (PLIC_THRESHOLD(ctx) + 4)
+// Sources 1 to 31, which covers every device in the example configs.
+// Enable and priority bits of sources that do not exist are hardwired
+// to zero, so enabling the whole range is harmless.
+#define PLIC_NSOURCES 32
+
+static inline void plic_enable_all(int ctx)
+{
+	for (int id = 1; id < PLIC_NSOURCES; id++)
+		reg_write32(PLIC_PRIORITY(id), 1);
+	reg_write32(PLIC_ENABLE(ctx), ~1U);
+	reg_write32(PLIC_THRESHOLD(ctx), 0);
+}
+
+static inline int plic_claim(int ctx)
+{
+	return reg_read32(PLIC_CLAIM(ctx));
+}
+
+static inline void plic_complete(int ctx, int id)
+{
+	reg_write32(PLIC_CLAIM(ctx), id);
+}
+
+#endif
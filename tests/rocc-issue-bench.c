@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "accum.h"
+#include "encoding.h"
+
+// RoCC command issue throughput on the accumulator (RoccExampleConfig).
+//
+// Each test issues NCOMMANDS adds and checks the final sum:
+//   fence-sync:   fence, then a blocking add (the old wrapper pattern)
+//   sync:         blocking add with no fence
+//   fence-posted: fence, then a posted add
+//   posted:       posted adds, with a completion count and a doorbell read
+//                 closing every batch of "batch" adds
+//
+// Results are CSV rows prefixed with "rocc-issue", the first of which
+// holds the column names. Cycles per command are printed times 100.
+
+#define NCOMMANDS 1024
+#define SUM_REG 0
+#define COUNTER_REG 1
+
+static const int batches[] = {1, 4, 16, 64, NCOMMANDS};
+#define NBATCHES (sizeof(batches) / sizeof(batches[0]))
+
+enum mode { FENCE_SYNC, SYNC, FENCE_POSTED, POSTED };
+
+static const char *mode_names[] = {
+	"fence-sync", "sync", "fence-posted", "posted"
+};
+
+volatile unsigned long sink_out;
+
+static void run_test(enum mode mode, int batch)
+{
+	unsigned long start, cycles, sum, sink = 0, completed;
+	int i;
+
+	accum_write(SUM_REG, 0);
+	accum_write(COUNTER_REG, 0);
+	accum_doorbell(COUNTER_REG);
+
+	start = rdcycle();
+
+	for (i = 0; i < NCOMMANDS; i++) {
+		switch (mode) {
+		case FENCE_SYNC:
+			asm volatile ("fence");
+			// Use the result so the core waits for it
+			sink += accum_add_sync(SUM_REG, i);
+			break;
+		case SYNC:
+			sink += accum_add_sync(SUM_REG, i);
+			break;
+		case FENCE_POSTED:
+			asm volatile ("fence");
+			accum_add(SUM_REG, i);
+			break;
+		case POSTED:
+			accum_add(SUM_REG, i);
+			if ((i + 1) % batch == 0) {
+				accum_complete(COUNTER_REG);
+				completed = accum_doorbell(COUNTER_REG);
+				if (completed != (i + 1) / batch) {
+					printf("Doorbell returned %lu, expected %d\n",
+						completed, (i + 1) / batch);
+					exit(EXIT_FAILURE);
+				}
+			}
+			break;
+		}
+	}
+
+	sum = accum_read(SUM_REG);
+	cycles = rdcycle() - start;
+
+	sink_out = sink;
+
+	if (sum != (unsigned long) NCOMMANDS * (NCOMMANDS - 1) / 2) {
+		printf("%s: accumulator holds %lu\n", mode_names[mode], sum);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("rocc-issue,%s,%d,%d,%lu,%lu\n",
+		mode_names[mode], batch, NCOMMANDS, cycles,
+		cycles * 100 / NCOMMANDS);
+}
+
+int main(void)
+{
+	printf("rocc-issue,mode,batch,commands,cycles,cycles_per_cmd_x100\n");
+
+	run_test(FENCE_SYNC, 1);
+	run_test(SYNC, 1);
+	run_test(FENCE_POSTED, NCOMMANDS);
+	for (int i = 0; i < NBATCHES; i++)
+		run_test(POSTED, batches[i]);
+
+	printf("All correct\n");
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef __STREAM_CHARCOUNT_H__
+#define __STREAM_CHARCOUNT_H__
+
+// Wrappers for the StreamingCharCount RoCC on custom3 (RoccExampleConfig).
+// A scan is started with stream_count_start() and runs in the background;
+// stream_count_result() waits for it and returns a count.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rocc.h"
+
+#define STREAM_COUNT_MAX_NEEDLES 8
+// Pass as the needle index to get the total over all needles
+#define STREAM_COUNT_TOTAL STREAM_COUNT_MAX_NEEDLES
+
+static inline void stream_count_set_needles(const char *needles, int n)
+{
+	uint64_t packed = 0;
+
+	for (int i = 0; i < n; i++)
+		packed |= (uint64_t) (uint8_t) needles[i] << (8 * i);
+
+	ROCC_INSTRUCTION_SS(3, packed, n, 0);
+}
+
+static inline void stream_count_start(const void *buf, size_t len)
+{
+	// The accelerator reads memory over TileLink, so earlier stores to
+	// the buffer must have left the core first
+	asm volatile ("fence");
+	ROCC_INSTRUCTION_SS(3, (uintptr_t) buf, len, 1);
+}
+
+static inline unsigned long stream_count_result(int needle)
+{
+	unsigned long count;
+	ROCC_INSTRUCTION_DS(3, count, needle, 2);
+	return count;
+}
+
+static inline int stream_count_done(void)
+{
+	unsigned long done;
+	ROCC_INSTRUCTION_D(3, done, 3);
+	return done;
+}
+
+#endif
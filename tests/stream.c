@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "encoding.h"
+
+// Integer version of the STREAM benchmark (McCalpin): copy, scale, add and
+// triad over arrays too large for the L1. Each kernel is run NTIMES and
+// the best run is reported, as STREAM does.
+//
+// Results are CSV rows prefixed with "stream", the first of which holds
+// the column names. Bandwidth is in bytes per kilocycle, counting bytes
+// read and written the way STREAM does.
+
+#ifndef STREAM_N
+#define STREAM_N 32768
+#endif
+#define NTIMES 3
+#define SCALAR 3
+
+uint64_t a[STREAM_N] __attribute__((aligned(64)));
+uint64_t b[STREAM_N] __attribute__((aligned(64)));
+uint64_t c[STREAM_N] __attribute__((aligned(64)));
+
+enum kernel { COPY, SCALE, ADD, TRIAD, NKERNELS };
+
+static const char *kernel_names[] = { "copy", "scale", "add", "triad" };
+static const int kernel_arrays[] = { 2, 2, 3, 3 };
+
+static void __attribute__((noinline)) run_kernel(enum kernel k)
+{
+	long i;
+
+	switch (k) {
+	case COPY:
+		for (i = 0; i < STREAM_N; i++)
+			c[i] = a[i];
+		break;
+	case SCALE:
+		for (i = 0; i < STREAM_N; i++)
+			b[i] = SCALAR * c[i];
+		break;
+	case ADD:
+		for (i = 0; i < STREAM_N; i++)
+			c[i] = a[i] + b[i];
+		break;
+	case TRIAD:
+		for (i = 0; i < STREAM_N; i++)
+			a[i] = b[i] + SCALAR * c[i];
+		break;
+	default:
+		break;
+	}
+}
+
+// Replays the kernels on scalars to get the values every element should
+// hold, as STREAM's checkSTREAMresults() does
+static void check_results(void)
+{
+	uint64_t aj = 1, bj = 2, cj = 0;
+	long i;
+
+	for (i = 0; i < NTIMES; i++) {
+		cj = aj;
+		bj = SCALAR * cj;
+		cj = aj + bj;
+		aj = bj + SCALAR * cj;
+	}
+
+	for (i = 0; i < STREAM_N; i++) {
+		if (a[i] != aj || b[i] != bj || c[i] != cj) {
+			printf("Element %ld wrong: %lu %lu %lu, expected "
+				"%lu %lu %lu\n", i, a[i], b[i], c[i],
+				aj, bj, cj);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned long best[NKERNELS], start, cycles;
+	unsigned long bytes;
+	long i;
+	int k, t;
+
+	for (i = 0; i < STREAM_N; i++) {
+		a[i] = 1;
+		b[i] = 2;
+		c[i] = 0;
+	}
+
+	for (k = 0; k < NKERNELS; k++)
+		best[k] = -1UL;
+
+	for (t = 0; t < NTIMES; t++) {
+		for (k = 0; k < NKERNELS; k++) {
+			start = rdcycle();
+			run_kernel(k);
+			cycles = rdcycle() - start;
+			if (cycles < best[k])
+				best[k] = cycles;
+		}
+	}
+
+	check_results();
+
+	printf("stream,kernel,array_bytes,best_cycles,bytes_per_kcycle\n");
+	for (k = 0; k < NKERNELS; k++) {
+		bytes = kernel_arrays[k] * sizeof(a);
+		printf("stream,%s,%lu,%lu,%lu\n", kernel_names[k],
+			sizeof(a), best[k], bytes * 1000 / best[k]);
+	}
+
+	return 0;
+}
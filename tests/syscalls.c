@@ -59,8 +59,17 @@ void __attribute__((noreturn)) tohost_exit(uintptr_t code)
   while (1);
 }
 
+uintptr_t __attribute__((weak)) handle_interrupt(uintptr_t cause, uintptr_t epc, uintptr_t regs[32])
+{
+  tohost_exit(1337);
+}
+
 uintptr_t __attribute__((weak)) handle_trap(uintptr_t cause, uintptr_t epc, uintptr_t regs[32])
 {
+  // programs that enable interrupts override handle_interrupt()
+  if ((intptr_t) cause < 0)
+    return handle_interrupt(cause & ~(1UL << (__riscv_xlen - 1)), epc, regs);
+
   tohost_exit(1337);
 }
 
@@ -0,0 +1,311 @@
+// See LICENSE for license details.
+
+// Record and replay of the design's external inputs.
+//
+// The serial port and the network port reach C++ through the DPI calls
+// serial_tick() (testchipip's SimSerial) and network_tick() (icenet's
+// SimNetwork), made once a cycle. The simulator is linked with
+// --wrap for both, so these wrappers sit between the design and the
+// models. When recording, they call through to the models and log the
+// arguments and results of every call where something changed. When
+// replaying, they hand back the logged results without calling the
+// models, so the front-end server and the tap device never run and every
+// input arrives on the cycle it did in the recording.
+//
+// While replaying, each call's arguments (the design's outputs) are also
+// checked against the log. A mismatch means the design behaves differently
+// from the one recorded. Its inputs are still replayed as recorded, so the
+// first divergence is the one to look at.
+//
+// Log format, all little-endian:
+//   header:  "EXTIO001", u32 random seed
+//   event:   u8 port, u64 call number on that port, then the port's state
+//   serial:  u8 out_valid, u8 in_ready, u32 out_bits,
+//            u8 out_ready, u8 in_valid, u32 in_bits, i32 result
+//   network: u8 out_valid, u8 out_last, u64 out_data,
+//            u8 in_valid, u8 in_last, u64 in_data
+
+#include "external-io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+extern "C" {
+int __real_serial_tick(unsigned char out_valid, unsigned char *out_ready,
+                       int out_bits, unsigned char *in_valid,
+                       unsigned char in_ready, int *in_bits);
+void __real_network_tick(unsigned char out_valid, long long out_data,
+                         unsigned char out_last, unsigned char *in_valid,
+                         long long *in_data, unsigned char *in_last);
+void __real_network_init(const char *devname);
+}
+
+enum { SERIAL, NETWORK, NPORTS };
+
+static const char *port_names[NPORTS] = { "serial", "network" };
+
+// Design outputs, then model outputs, packed as in the log. Data that is
+// not valid is zeroed, so it neither makes a new event nor a divergence.
+struct port_state_t {
+  std::vector<uint8_t> bytes;
+
+  template <class T> void put(T v)
+  {
+    for (size_t i = 0; i < sizeof(T); i++)
+      bytes.push_back((uint64_t) v >> (8 * i));
+  }
+
+  template <class T> T get(size_t &off) const
+  {
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+      v |= (uint64_t) bytes[off++] << (8 * i);
+    return (T) v;
+  }
+};
+
+struct event_t {
+  uint64_t call;
+  port_state_t state;
+};
+
+struct port_t {
+  uint64_t calls = 0;
+  port_state_t last;
+  bool any = false;
+
+  // Replay
+  std::vector<event_t> events;
+  size_t next = 0;
+};
+
+static FILE *record_file;
+static FILE *divergence_file;
+static bool replaying;
+static port_t ports[NPORTS];
+static uint64_t divergences;
+static int exit_code;
+
+static const size_t state_sizes[NPORTS] = { 6 + 10, 10 + 10 };
+static const size_t output_sizes[NPORTS] = { 6, 10 };
+static const uint64_t max_logged_divergences = 100;
+
+void external_io_record(const char *path, uint32_t seed)
+{
+  record_file = fopen(path, "wb");
+  if (!record_file) {
+    perror(path);
+    abort();
+  }
+  setvbuf(record_file, NULL, _IOFBF, 1 << 20);
+  fwrite("EXTIO001", 1, 8, record_file);
+  fwrite(&seed, sizeof(seed), 1, record_file);
+}
+
+uint32_t external_io_replay(const char *path, const char *divergence_path)
+{
+  FILE *f = fopen(path, "rb");
+  char magic[8];
+  uint32_t seed;
+
+  if (!f) {
+    perror(path);
+    abort();
+  }
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, "EXTIO001", 8) ||
+      fread(&seed, sizeof(seed), 1, f) != 1) {
+    fprintf(stderr, "%s: not an external IO recording\n", path);
+    abort();
+  }
+
+  for (;;) {
+    uint8_t port;
+    event_t ev;
+
+    if (fread(&port, 1, 1, f) != 1)
+      break;
+    if (port >= NPORTS || fread(&ev.call, 8, 1, f) != 1) {
+      fprintf(stderr, "%s: corrupt recording\n", path);
+      abort();
+    }
+    ev.state.bytes.resize(state_sizes[port]);
+    if (fread(ev.state.bytes.data(), 1, state_sizes[port], f) !=
+        state_sizes[port]) {
+      fprintf(stderr, "%s: truncated recording\n", path);
+      abort();
+    }
+    ports[port].events.push_back(ev);
+  }
+  fclose(f);
+
+  divergence_file = stderr;
+  if (divergence_path) {
+    divergence_file = fopen(divergence_path, "w");
+    if (!divergence_file) {
+      perror(divergence_path);
+      abort();
+    }
+  }
+  replaying = true;
+  return seed;
+}
+
+bool external_io_replaying()
+{
+  return replaying;
+}
+
+int external_io_exit_code()
+{
+  return exit_code;
+}
+
+uint64_t external_io_close()
+{
+  if (record_file)
+    fclose(record_file);
+  if (replaying) {
+    for (int p = 0; p < NPORTS; p++) {
+      if (ports[p].next < ports[p].events.size()) {
+        fprintf(divergence_file, "%s: run ended at call %lu, before the "
+                "recording did\n", port_names[p],
+                (unsigned long) ports[p].calls);
+        divergences++;
+      }
+    }
+    if (divergences)
+      fprintf(stderr, "replay diverged from the recording on %lu cycles\n",
+              (unsigned long) divergences);
+    if (divergence_file != stderr)
+      fclose(divergence_file);
+  }
+  record_file = NULL;
+  return divergences;
+}
+
+static void record(int p, const port_state_t &state)
+{
+  port_t &port = ports[p];
+  uint64_t call = port.calls++;
+
+  if (port.any && port.last.bytes == state.bytes)
+    return;
+  port.last = state;
+  port.any = true;
+
+  uint8_t id = p;
+  fwrite(&id, 1, 1, record_file);
+  fwrite(&call, 8, 1, record_file);
+  fwrite(state.bytes.data(), 1, state.bytes.size(), record_file);
+}
+
+// Returns the recorded state for this call, having checked the design's
+// outputs against it
+static const port_state_t &replay(int p, const port_state_t &outputs)
+{
+  static port_state_t idle;
+  port_t &port = ports[p];
+  uint64_t call = port.calls++;
+
+  while (port.next < port.events.size() &&
+         port.events[port.next].call <= call)
+    port.next++;
+
+  // Before the first event nothing has happened on the port yet
+  if (port.next == 0) {
+    idle.bytes.assign(state_sizes[p], 0);
+    return idle;
+  }
+
+  const port_state_t &state = port.events[port.next - 1].state;
+  for (size_t i = 0; i < output_sizes[p]; i++) {
+    if (outputs.bytes[i] != state.bytes[i]) {
+      if (divergences < max_logged_divergences) {
+        fprintf(divergence_file, "%s: call %lu: design output differs from "
+                "the recording at byte %lu (%02x, recorded %02x)\n",
+                port_names[p], (unsigned long) call, (unsigned long) i,
+                outputs.bytes[i], state.bytes[i]);
+      }
+      divergences++;
+      break;
+    }
+  }
+  return state;
+}
+
+extern "C" int __wrap_serial_tick(unsigned char out_valid,
+                                  unsigned char *out_ready, int out_bits,
+                                  unsigned char *in_valid,
+                                  unsigned char in_ready, int *in_bits)
+{
+  port_state_t s;
+  int result;
+
+  s.put<uint8_t>(out_valid);
+  s.put<uint8_t>(in_ready);
+  s.put<uint32_t>(out_valid ? out_bits : 0);
+
+  if (replaying) {
+    const port_state_t &r = replay(SERIAL, s);
+    size_t off = output_sizes[SERIAL];
+    *out_ready = r.get<uint8_t>(off);
+    *in_valid = r.get<uint8_t>(off);
+    *in_bits = r.get<uint32_t>(off);
+    result = r.get<int32_t>(off);
+    if (result)
+      exit_code = result >> 1;
+    return result;
+  }
+
+  result = __real_serial_tick(out_valid, out_ready, out_bits, in_valid,
+                              in_ready, in_bits);
+  if (record_file) {
+    s.put<uint8_t>(*out_ready);
+    s.put<uint8_t>(*in_valid);
+    s.put<uint32_t>(*in_bits);
+    s.put<int32_t>(result);
+    record(SERIAL, s);
+  }
+  return result;
+}
+
+extern "C" void __wrap_network_tick(unsigned char out_valid,
+                                    long long out_data,
+                                    unsigned char out_last,
+                                    unsigned char *in_valid,
+                                    long long *in_data,
+                                    unsigned char *in_last)
+{
+  port_state_t s;
+
+  s.put<uint8_t>(out_valid);
+  s.put<uint8_t>(out_valid ? out_last : 0);
+  s.put<uint64_t>(out_valid ? out_data : 0);
+
+  if (replaying) {
+    const port_state_t &r = replay(NETWORK, s);
+    size_t off = output_sizes[NETWORK];
+    *in_valid = r.get<uint8_t>(off);
+    *in_last = r.get<uint8_t>(off);
+    *in_data = r.get<uint64_t>(off);
+    return;
+  }
+
+  __real_network_tick(out_valid, out_data, out_last, in_valid, in_data,
+                      in_last);
+  if (record_file) {
+    s.put<uint8_t>(*in_valid);
+    s.put<uint8_t>(*in_last);
+    s.put<uint64_t>(*in_data);
+    record(NETWORK, s);
+  }
+}
+
+// Replays need no tap device
+extern "C" void __wrap_network_init(const char *devname)
+{
+  if (!replaying)
+    __real_network_init(devname);
+}
@@ -0,0 +1,30 @@
+// See LICENSE for license details.
+
+#ifndef __EXTERNAL_IO_H__
+#define __EXTERNAL_IO_H__
+
+#include <stdint.h>
+
+// Record and replay of the simulation's external inputs: what the host
+// serial port (the front-end server) and the network model (the tap
+// device) hand the design each cycle. See external-io.cc.
+
+// Logs every change to the serial and network ports to path, along with
+// the seed the simulation's random initial state came from
+void external_io_record(const char *path, uint32_t seed);
+
+// Plays back a log instead of running the front-end server and the network
+// model, and returns the seed to start from. Cycles where the design's
+// outputs differ from the recording are logged to divergence_path, or
+// stderr if it is NULL.
+uint32_t external_io_replay(const char *path, const char *divergence_path);
+
+bool external_io_replaying();
+
+// The exit code the program returned in the recording
+int external_io_exit_code();
+
+// Finishes the log or the replay; returns the number of divergent cycles
+uint64_t external_io_close();
+
+#endif
@@ -0,0 +1,132 @@
+// See LICENSE for license details.
+
+#ifndef __PC_SAMPLER_H__
+#define __PC_SAMPLER_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Samples the PC of hart 0 every N cycles, from the trace tap on the test
+// harness, for scripts/pcprof.py.
+//
+// Alongside the PC it keeps a shadow call stack by watching retired calls
+// (jal/jalr that link to ra or t0) and returns (jalr x0 through ra or t0),
+// so each sample also carries the return addresses of the functions it is
+// nested in. The stack can get out of step with code that does not call
+// and return in pairs (longjmp, traps); it never pops below empty.
+//
+// File format, all little-endian:
+//   header:  "PCSAMPL1", u64 interval in cycles
+//   sample:  u64 pc, u32 depth, u32 zero, then depth u64 return addresses,
+//            outermost first
+class pc_sampler_t
+{
+  public:
+    pc_sampler_t(const char *path, uint64_t interval)
+      : interval(interval), countdown(interval), last_pc(0), samples(0)
+    {
+      file = fopen(path, "wb");
+      if (!file) {
+        perror(path);
+        abort();
+      }
+      setvbuf(file, NULL, _IOFBF, 1 << 20);
+      fwrite("PCSAMPL1", 1, 8, file);
+      fwrite(&interval, sizeof(interval), 1, file);
+    }
+
+    ~pc_sampler_t()
+    {
+      // The trace tap is bored out of the core and reads zero when FIRRTL
+      // did not run its wiring transform
+      if (samples == 0)
+        fprintf(stderr, "pc-sample: no instructions retired on the trace "
+                "tap, so no samples were taken\n");
+      fclose(file);
+    }
+
+    // Called once per cycle
+    void tick(bool valid, uint64_t pc, uint32_t insn)
+    {
+      if (valid) {
+        retire(pc, insn);
+        last_pc = pc;
+      }
+
+      if (--countdown == 0) {
+        countdown = interval;
+        if (last_pc)
+          sample();
+      }
+    }
+
+  private:
+    FILE *file;
+    uint64_t interval;
+    uint64_t countdown;
+    uint64_t last_pc;
+    uint64_t samples;
+    std::vector<uint64_t> stack;
+
+    static const size_t max_depth = 256;
+
+    static bool is_link(int reg)
+    {
+      return reg == 1 || reg == 5;
+    }
+
+    void call(uint64_t ret)
+    {
+      if (stack.size() < max_depth)
+        stack.push_back(ret);
+    }
+
+    void ret()
+    {
+      if (!stack.empty())
+        stack.pop_back();
+    }
+
+    void retire(uint64_t pc, uint32_t insn)
+    {
+      if ((insn & 3) != 3) {
+        // c.jr and c.jalr: quadrant 2, funct4 100x, rs1 != 0, rs2 == 0
+        int funct4 = (insn >> 12) & 0xf;
+        int rs1 = (insn >> 7) & 0x1f;
+        int rs2 = (insn >> 2) & 0x1f;
+        if ((insn & 3) != 2 || rs1 == 0 || rs2 != 0)
+          return;
+        if (funct4 == 0x9)
+          call(pc + 2);
+        else if (funct4 == 0x8 && is_link(rs1))
+          ret();
+        return;
+      }
+
+      int opcode = insn & 0x7f;
+      int rd = (insn >> 7) & 0x1f;
+      int rs1 = (insn >> 15) & 0x1f;
+
+      if (opcode == 0x6f && is_link(rd))
+        call(pc + 4);
+      else if (opcode == 0x67 && is_link(rd))
+        call(pc + 4);
+      else if (opcode == 0x67 && rd == 0 && is_link(rs1))
+        ret();
+    }
+
+    void sample()
+    {
+      uint32_t hdr[2] = { (uint32_t) stack.size(), 0 };
+
+      samples++;
+      fwrite(&last_pc, sizeof(last_pc), 1, file);
+      fwrite(hdr, sizeof(hdr), 1, file);
+      if (!stack.empty())
+        fwrite(stack.data(), sizeof(uint64_t), stack.size(), file);
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+// See LICENSE for license details.
+
+#ifndef __RUN_BUDGET_H__
+#define __RUN_BUDGET_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Wall-clock and memory limits for a simulation, and a heartbeat on stderr
+// to show it is still making progress. The harness calls check() every
+// few thousand cycles and, once a limit is hit, leaves its main loop the
+// same way it does at the end of a run, so traces and reports still get
+// written.
+class run_budget_t
+{
+  public:
+    enum { OK, TIME, MEMORY };
+
+    // Zero turns off the corresponding limit or the heartbeat
+    run_budget_t(uint64_t max_seconds, uint64_t max_rss_mb,
+                 uint64_t heartbeat_seconds)
+      : max_seconds(max_seconds), max_rss_mb(max_rss_mb),
+        heartbeat_seconds(heartbeat_seconds), last_beat_cycle(0)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      last_beat = 0;
+    }
+
+    int check(uint64_t cycle, uint64_t pc)
+    {
+      double secs = elapsed();
+
+      if (heartbeat_seconds && secs - last_beat >= heartbeat_seconds) {
+        double khz = (cycle - last_beat_cycle) / (secs - last_beat) / 1000;
+        fprintf(stderr, "heartbeat: cycle %lu, %.0f s, %.1f kHz, "
+                "%lu MiB, pc 0x%lx\n", (unsigned long) cycle, secs, khz,
+                (unsigned long) rss_mb(), (unsigned long) pc);
+        last_beat = secs;
+        last_beat_cycle = cycle;
+      }
+
+      if (max_seconds && secs >= max_seconds)
+        return TIME;
+      if (max_rss_mb && rss_mb() >= max_rss_mb)
+        return MEMORY;
+      return OK;
+    }
+
+    double elapsed()
+    {
+      struct timespec now;
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    }
+
+    // Resident set size now, or at its peak where /proc is not available
+    static uint64_t rss_mb()
+    {
+      FILE *f = fopen("/proc/self/statm", "r");
+      unsigned long size, resident;
+
+      if (f) {
+        int n = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+        if (n == 2)
+          return resident * sysconf(_SC_PAGESIZE) >> 20;
+      }
+
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      return usage.ru_maxrss >> 10;
+    }
+
+  private:
+    uint64_t max_seconds;
+    uint64_t max_rss_mb;
+    uint64_t heartbeat_seconds;
+    struct timespec start;
+    double last_beat;
+    uint64_t last_beat_cycle;
+};
+
+#endif
@@ -0,0 +1,19 @@
+// See LICENSE for license details.
+
+// DPI side of vsim/vsrc/SimPerf.v, compiled into the VCS simulator only:
+// times the run from the end of reset and prints its throughput the way
+// the Verilator simulator does.
+
+#include "sim-perf.h"
+
+static run_budget_t *timer;
+
+extern "C" void sim_perf_start()
+{
+  timer = new run_budget_t(0, 0, 0);
+}
+
+extern "C" void sim_perf_report(long long cycles)
+{
+  print_sim_perf("vcs", cycles, timer ? timer->elapsed() : 0);
+}
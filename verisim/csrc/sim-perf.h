@@ -0,0 +1,24 @@
+// See LICENSE for license details.
+
+#ifndef __SIM_PERF_H__
+#define __SIM_PERF_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "run-budget.h"
+
+// Throughput of a run, printed by both the Verilator and the VCS simulator
+// for +sim-perf in the same form, so the two can be compared on the same
+// programs. The cycles and seconds count from the end of reset.
+static inline void print_sim_perf(const char *simulator, uint64_t cycles,
+                                  double seconds)
+{
+  fprintf(stderr, "sim-perf,simulator,cycles,seconds,khz,rss_mb\n");
+  fprintf(stderr, "sim-perf,%s,%lu,%.3f,%.2f,%lu\n", simulator,
+          (unsigned long) cycles, seconds,
+          seconds > 0 ? cycles / seconds / 1000 : 0.0,
+          (unsigned long) run_budget_t::rss_mb());
+}
+
+#endif
@@ -0,0 +1,222 @@
+// See LICENSE for license details.
+
+#ifndef __STATS_SERVER_H__
+#define __STATS_SERVER_H__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// Counters the harness keeps while a stats server is running
+struct sim_stats_t {
+  uint64_t cycle = 0;
+  uint64_t host_reads = 0;       // front-end server accesses to target memory,
+  uint64_t host_writes = 0;      // which is how tohost and syscalls are seen
+  uint64_t host_bytes = 0;
+  uint64_t nic_tx_packets = 0;
+  uint64_t nic_rx_packets = 0;
+  uint64_t blkdev_requests = 0;
+  uint64_t mem_read_bytes = 0;
+  uint64_t mem_write_bytes = 0;
+  uint64_t mem_reads = 0;
+  uint64_t mem_writes = 0;
+};
+
+// Answers queries about a running simulation on a Unix domain socket, so a
+// long run can be watched without stopping it. The harness calls poll()
+// every few thousand cycles; everything is non-blocking, so the simulation
+// never waits for a client.
+//
+// Clients send one command per line:
+//   stats        reply with the counters, as CSV rows "stats,counter,value"
+//   dump         also print the counters, and the +traffic and +topdown
+//                reports so far, to the simulator's own output
+//   trace-start  start dumping the waveform (needs -v)
+//   trace-stop   stop dumping the waveform
+//
+//   echo stats | socat - UNIX-CONNECT:sim.sock
+class stats_server_t
+{
+  public:
+    enum {
+      DUMP = 1,
+      TRACE_START = 2,
+      TRACE_STOP = 4,
+    };
+
+    stats_server_t(const char *path) : path(path)
+    {
+      struct sockaddr_un addr;
+
+      if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "stats socket path too long: %s\n", path);
+        abort();
+      }
+
+      listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (listen_fd < 0) {
+        perror("socket");
+        abort();
+      }
+
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path);
+      unlink(path);
+      if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+          listen(listen_fd, 4) < 0) {
+        perror(path);
+        abort();
+      }
+      fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
+    ~stats_server_t()
+    {
+      for (auto &c : clients)
+        close(c.fd);
+      close(listen_fd);
+      unlink(path.c_str());
+    }
+
+    // Accepts new clients and answers their commands. Returns the actions
+    // the harness has to take itself, as a mask of DUMP, TRACE_START and
+    // TRACE_STOP.
+    int poll(const sim_stats_t &stats, bool can_trace)
+    {
+      int actions = 0;
+      int fd;
+
+      while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        clients.push_back(client_t { fd, "" });
+      }
+
+      for (size_t i = 0; i < clients.size(); ) {
+        if (serve(clients[i], stats, can_trace, actions)) {
+          i++;
+        } else {
+          close(clients[i].fd);
+          clients.erase(clients.begin() + i);
+        }
+      }
+
+      return actions;
+    }
+
+    void print(FILE *out, const sim_stats_t &stats)
+    {
+      std::string s = format(stats);
+      fwrite(s.data(), 1, s.size(), out);
+      fflush(out);
+    }
+
+  private:
+    struct client_t {
+      int fd;
+      std::string line;
+    };
+
+    std::string path;
+    int listen_fd;
+    std::vector<client_t> clients;
+    struct timespec start;
+
+    // Returns false once the client has gone away
+    bool serve(client_t &c, const sim_stats_t &stats, bool can_trace,
+               int &actions)
+    {
+      char buf[256];
+      ssize_t n;
+
+      while ((n = read(c.fd, buf, sizeof(buf))) > 0)
+        c.line.append(buf, n);
+
+      // A client that sends its commands and then shuts down its side, as
+      // "echo stats | socat ..." does, still gets its replies before the
+      // connection is closed
+      bool gone = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+      if (gone && !c.line.empty() && c.line.back() != '\n')
+        c.line += '\n';
+
+      size_t eol;
+      while ((eol = c.line.find('\n')) != std::string::npos) {
+        std::string cmd = c.line.substr(0, eol);
+        std::string reply;
+
+        c.line.erase(0, eol + 1);
+        if (!cmd.empty() && cmd.back() == '\r')
+          cmd.pop_back();
+
+        if (cmd == "stats") {
+          reply = format(stats);
+        } else if (cmd == "dump") {
+          actions |= DUMP;
+          reply = "ok\n";
+        } else if (cmd == "trace-start" || cmd == "trace-stop") {
+          if (!can_trace) {
+            reply = "error: no waveform, run with -v<file>\n";
+          } else {
+            actions |= cmd == "trace-start" ? TRACE_START : TRACE_STOP;
+            reply = "ok\n";
+          }
+        } else if (!cmd.empty()) {
+          reply = "error: unknown command " + cmd + "\n";
+        }
+
+        if (!reply.empty() &&
+            send(c.fd, reply.data(), reply.size(),
+                 MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t) reply.size())
+          return false;
+      }
+
+      return !gone;
+    }
+
+    std::string format(const sim_stats_t &s)
+    {
+      struct timespec now;
+      char buf[1024];
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      double secs = (now.tv_sec - start.tv_sec) +
+                    (now.tv_nsec - start.tv_nsec) / 1e9;
+
+      snprintf(buf, sizeof(buf),
+        "stats,counter,value\n"
+        "stats,cycle,%lu\n"
+        "stats,seconds,%.0f\n"
+        "stats,khz,%.0f\n"
+        "stats,host_reads,%lu\n"
+        "stats,host_writes,%lu\n"
+        "stats,host_bytes,%lu\n"
+        "stats,nic_tx_packets,%lu\n"
+        "stats,nic_rx_packets,%lu\n"
+        "stats,blkdev_requests,%lu\n"
+        "stats,mem_reads,%lu\n"
+        "stats,mem_writes,%lu\n"
+        "stats,mem_read_bytes,%lu\n"
+        "stats,mem_write_bytes,%lu\n",
+        (unsigned long) s.cycle, secs, secs > 0 ? s.cycle / secs / 1000 : 0,
+        (unsigned long) s.host_reads, (unsigned long) s.host_writes,
+        (unsigned long) s.host_bytes,
+        (unsigned long) s.nic_tx_packets, (unsigned long) s.nic_rx_packets,
+        (unsigned long) s.blkdev_requests,
+        (unsigned long) s.mem_reads, (unsigned long) s.mem_writes,
+        (unsigned long) s.mem_read_bytes, (unsigned long) s.mem_write_bytes);
+      return buf;
+    }
+};
+
+#endif
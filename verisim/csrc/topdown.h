@@ -0,0 +1,96 @@
+// See LICENSE for license details.
+
+#ifndef __TOPDOWN_H__
+#define __TOPDOWN_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+// Top-down cycle breakdown of hart 0, per code region.
+//
+// Each cycle the test harness's trace tap says what the core's decode slot
+// did (see TopDown in src/main/scala/example/TraceTap.scala, whose
+// encoding this shares), and the cycle is added to the innermost open
+// region. Regions are opened and closed by "slti x0, x0, id" markers
+// (tests/perf-region.h) as they retire; id 0 closes the innermost one.
+class topdown_t
+{
+  public:
+    enum {
+      UNKNOWN,
+      RETIRING,
+      FRONTEND,
+      BAD_SPECULATION,
+      BACKEND_MEMORY,
+      BACKEND_CORE,
+      NSLOTS,
+    };
+
+    topdown_t() : region(0) {}
+
+    // Called once per cycle
+    void tick(bool valid, uint32_t insn, int slot)
+    {
+      if (slot < 0 || slot >= NSLOTS)
+        slot = UNKNOWN;
+      counts[region].cycles[slot]++;
+
+      if (valid && (insn & 0xfffff) == 0x02013) {
+        // slti x0, x0, imm
+        int id = (int32_t) insn >> 20;
+        if (id > 0) {
+          open.push_back(region);
+          region = id;
+        } else if (!open.empty()) {
+          region = open.back();
+          open.pop_back();
+        }
+      }
+    }
+
+    // One CSV row per region, in the style of the benchmarks in tests/,
+    // with each class as a share of the region's cycles times 1000
+    void report(FILE *out)
+    {
+      uint64_t retiring = 0;
+
+      fprintf(out, "topdown,region,cycles,retiring,frontend,bad_speculation,"
+                   "backend_memory,backend_core,unknown\n");
+      for (auto &it : counts) {
+        const uint64_t *c = it.second.cycles;
+        uint64_t total = 0;
+
+        for (int i = 0; i < NSLOTS; i++)
+          total += c[i];
+        if (total == 0)
+          continue;
+        retiring += c[RETIRING];
+
+        fprintf(out, "topdown,%d,%lu", it.first, (unsigned long) total);
+        for (int i : { RETIRING, FRONTEND, BAD_SPECULATION,
+                       BACKEND_MEMORY, BACKEND_CORE, UNKNOWN })
+          fprintf(out, ",%lu", (unsigned long) (c[i] * 1000 / total));
+        fprintf(out, "\n");
+      }
+      fflush(out);
+
+      // The slot is bored out of the core; if FIRRTL did not wire it up,
+      // it reads zero and no cycle ever retires
+      if (!counts.empty() && retiring == 0)
+        fprintf(stderr, "topdown: no cycles retired an instruction; "
+                "the trace tap is probably not connected\n");
+    }
+
+  private:
+    struct region_counts_t {
+      uint64_t cycles[NSLOTS] = {};
+    };
+
+    int region;
+    std::vector<int> open;
+    std::map<int, region_counts_t> counts;
+};
+
+#endif
@@ -0,0 +1,232 @@
+// See LICENSE for license details.
+
+#ifndef __TRAFFIC_MONITOR_H__
+#define __TRAFFIC_MONITOR_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// Bus traffic statistics from the test harness's traffic taps (see
+// TrafficTaps in src/main/scala/example/TrafficMonitor.scala).
+//
+// Each port reports the first beat of every request and the last beat of
+// the response that completes it. Requests are split into reads and writes
+// and by target, DRAM or MMIO, and for each the monitor counts
+// transactions and bytes and keeps a histogram of latency in power-of-two
+// buckets. With an interval, it also prints the traffic on each port every
+// interval cycles, for plotting how ports contend over time.
+//
+// Output is CSV in the style of the benchmarks in tests/: the first row of
+// each table holds the column names.
+class traffic_monitor_t
+{
+  public:
+    traffic_monitor_t(FILE *out, uint64_t interval)
+      : out(out), interval(interval), cycle(0), printed_interval(false) {}
+
+    // Returns the port number to pass to req() and resp(). A port that is
+    // always busy, like a core's, and reports no traffic in a whole run
+    // is warned about: its tap is most likely not connected.
+    int add_port(const char *name, bool always_busy = false)
+    {
+      ports.push_back(port_t(name, always_busy));
+      return ports.size() - 1;
+    }
+
+    void req(int n, bool write, uint32_t id, uint64_t addr, uint32_t bytes)
+    {
+      port_t &port = ports[n];
+      int target = addr >= DRAM_BASE ? DRAM : MMIO;
+      stats_t &s = port.stats[target][write];
+
+      s.txns++;
+      s.bytes += bytes;
+      port.window.bytes[write] += bytes;
+      port.window.txns[write]++;
+      port.outstanding[key(write, id)].push_back(inflight_t { cycle, target });
+      port.inflight++;
+    }
+
+    void resp(int n, bool write, uint32_t id)
+    {
+      port_t &port = ports[n];
+      std::deque<inflight_t> &q = port.outstanding[key(write, id)];
+
+      // Responses to requests the tap does not report, like a Release
+      // without data, have nothing to match
+      if (q.empty())
+        return;
+
+      // AXI4 completes requests with the same id in order
+      port.stats[q.front().target][write].add_latency(cycle - q.front().start);
+      q.pop_front();
+      port.inflight--;
+    }
+
+    // Transactions and bytes so far on a port, in one direction
+    void totals(int n, bool write, uint64_t &txns, uint64_t &bytes)
+    {
+      txns = bytes = 0;
+      for (int t = 0; t < NTARGETS; t++) {
+        txns += ports[n].stats[t][write].txns;
+        bytes += ports[n].stats[t][write].bytes;
+      }
+    }
+
+    // Called once per cycle, after the cycle's requests and responses
+    void tick()
+    {
+      cycle++;
+      if (interval && cycle % interval == 0)
+        print_interval();
+    }
+
+    void report()
+    {
+      fprintf(out, "traffic,port,target,dir,txns,bytes,bytes_per_kcycle,"
+                   "avg_latency,max_latency\n");
+      for (auto &port : ports) {
+        for (int t = 0; t < NTARGETS; t++) {
+          for (int w = 0; w < 2; w++) {
+            stats_t &s = port.stats[t][w];
+            if (!s.txns)
+              continue;
+            fprintf(out, "traffic,%s,%s,%s,%lu,%lu,%lu,%lu,%lu\n",
+                    port.name.c_str(), target_name(t), dir_name(w),
+                    (unsigned long) s.txns, (unsigned long) s.bytes,
+                    (unsigned long) (cycle ? s.bytes * 1000 / cycle : 0),
+                    (unsigned long) (s.done ? s.latency / s.done : 0),
+                    (unsigned long) s.max_latency);
+          }
+        }
+      }
+
+      fprintf(out, "traffic-latency,port,target,dir,min_cycles,max_cycles,"
+                   "count\n");
+      for (auto &port : ports) {
+        for (int t = 0; t < NTARGETS; t++) {
+          for (int w = 0; w < 2; w++) {
+            stats_t &s = port.stats[t][w];
+            for (int b = 0; b < NBUCKETS; b++) {
+              if (!s.histogram[b])
+                continue;
+              fprintf(out, "traffic-latency,%s,%s,%s,%lu,%lu,%lu\n",
+                      port.name.c_str(), target_name(t), dir_name(w),
+                      b ? 1UL << (b - 1) : 0UL, (1UL << b) - 1,
+                      (unsigned long) s.histogram[b]);
+            }
+          }
+        }
+      }
+      fflush(out);
+
+      for (int n = 0; n < (int) ports.size(); n++) {
+        uint64_t reads, writes, bytes;
+
+        totals(n, false, reads, bytes);
+        totals(n, true, writes, bytes);
+        if (ports[n].always_busy && cycle && !reads && !writes)
+          fprintf(stderr, "traffic: no transactions on port %s; its tap is "
+                  "probably not connected\n", ports[n].name.c_str());
+      }
+    }
+
+  private:
+    static const uint64_t DRAM_BASE = 0x80000000UL;
+    enum { DRAM, MMIO, NTARGETS };
+    static const int NBUCKETS = 32;
+
+    struct stats_t {
+      uint64_t txns = 0;
+      uint64_t bytes = 0;
+      uint64_t done = 0;
+      uint64_t latency = 0;
+      uint64_t max_latency = 0;
+      uint64_t histogram[NBUCKETS] = {};
+
+      void add_latency(uint64_t cycles)
+      {
+        int b = 0;
+
+        while (b < NBUCKETS - 1 && cycles >> b)
+          b++;
+        histogram[b]++;
+        done++;
+        latency += cycles;
+        if (cycles > max_latency)
+          max_latency = cycles;
+      }
+    };
+
+    struct inflight_t {
+      uint64_t start;
+      int target;
+    };
+
+    struct window_t {
+      uint64_t bytes[2] = {};
+      uint64_t txns[2] = {};
+    };
+
+    struct port_t {
+      std::string name;
+      stats_t stats[NTARGETS][2];
+      std::map<uint64_t, std::deque<inflight_t>> outstanding;
+      uint64_t inflight;
+      window_t window;
+
+      bool always_busy;
+
+      port_t(const char *name, bool always_busy)
+        : name(name), inflight(0), always_busy(always_busy) {}
+    };
+
+    FILE *out;
+    uint64_t interval;
+    uint64_t cycle;
+    bool printed_interval;
+    std::vector<port_t> ports;
+
+    static const char *target_name(int target)
+    {
+      return target == DRAM ? "dram" : "mmio";
+    }
+
+    static const char *dir_name(int write)
+    {
+      return write ? "write" : "read";
+    }
+
+    static uint64_t key(bool write, uint32_t id)
+    {
+      return ((uint64_t) write << 32) | id;
+    }
+
+    // Ports with no traffic in the interval are left out
+    void print_interval()
+    {
+      if (!printed_interval) {
+        fprintf(out, "traffic-interval,cycle,port,read_bytes,write_bytes,"
+                     "read_txns,write_txns,outstanding\n");
+        printed_interval = true;
+      }
+
+      for (auto &port : ports) {
+        window_t &w = port.window;
+        if (!w.txns[0] && !w.txns[1] && !port.inflight)
+          continue;
+        fprintf(out, "traffic-interval,%lu,%s,%lu,%lu,%lu,%lu,%lu\n",
+                (unsigned long) cycle, port.name.c_str(),
+                (unsigned long) w.bytes[0], (unsigned long) w.bytes[1],
+                (unsigned long) w.txns[0], (unsigned long) w.txns[1],
+                (unsigned long) port.inflight);
+        w = window_t();
+      }
+    }
+};
+
+#endif
@@ -1,6 +1,10 @@
 // See LICENSE for license details.
 
 #include "verilated.h"
+// The model's header is included here only, rather than forced into every
+// file Verilator compiles, so the runtime's objects are the same for every
+// config and ccache can share them
+#include "VTestHarness.h"
 #if VM_TRACE
 #include "verilated_vcd_c.h"
 #endif
@@ -12,6 +16,19 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "pc-sampler.h"
+#include "topdown.h"
+#include "traffic-monitor.h"
+#include "stats-server.h"
+#include "external-io.h"
+#include "run-budget.h"
+#include "sim-perf.h"
+
+// Set by the Makefile: 0 for designs whose harness ties off the core tap
+#ifndef CORE_TRAFFIC_TAP
+#define CORE_TRAFFIC_TAP 1
+#endif
+
 extern tsi_t* tsi;
 static uint64_t trace_count = 0;
 bool verbose;
@@ -53,6 +70,58 @@ static inline int copy_argv(int argc, char **argv, char **new_argv)
     return new_argc;
 }
 
+static sim_stats_t stats;
+
+// Counts the front-end server's accesses to target memory for the stats
+// server
+class counting_tsi_t : public tsi_t
+{
+  public:
+    counting_tsi_t(int argc, char **argv) : tsi_t(argc, argv) {}
+
+  protected:
+    void read_chunk(addr_t taddr, size_t nbytes, void* dst) override
+    {
+      stats.host_reads++;
+      stats.host_bytes += nbytes;
+      tsi_t::read_chunk(taddr, nbytes, dst);
+    }
+
+    void write_chunk(addr_t taddr, size_t nbytes, const void* src) override
+    {
+      stats.host_writes++;
+      stats.host_bytes += nbytes;
+      tsi_t::write_chunk(taddr, nbytes, src);
+    }
+};
+
+// Feeds one port of the harness's traffic taps to the monitor
+#define TRAFFIC_REQ(n, port, i) \
+  if (tile->io_traffic_##port##_req_##i##_valid) \
+    traffic->req(n, tile->io_traffic_##port##_req_##i##_bits_write, \
+                 tile->io_traffic_##port##_req_##i##_bits_id, \
+                 tile->io_traffic_##port##_req_##i##_bits_addr, \
+                 tile->io_traffic_##port##_req_##i##_bits_bytes)
+#define TRAFFIC_RESP(n, port, i) \
+  if (tile->io_traffic_##port##_resp_##i##_valid) \
+    traffic->resp(n, tile->io_traffic_##port##_resp_##i##_bits_write, \
+                  tile->io_traffic_##port##_resp_##i##_bits_id)
+#define TRAFFIC_PORT(n, port) do { \
+    TRAFFIC_REQ(n, port, 0); \
+    TRAFFIC_REQ(n, port, 1); \
+    TRAFFIC_RESP(n, port, 0); \
+    TRAFFIC_RESP(n, port, 1); \
+  } while (0)
+
+static void monitor_traffic(VTestHarness *tile, traffic_monitor_t *traffic)
+{
+  TRAFFIC_PORT(0, mem);
+  TRAFFIC_PORT(1, core);
+  TRAFFIC_PORT(2, blkdev);
+  TRAFFIC_PORT(3, icenic);
+  traffic->tick();
+}
+
 int main(int argc, char** argv)
 {
   unsigned random_seed = (unsigned)time(NULL) ^ (unsigned)getpid();
@@ -61,6 +130,34 @@ int main(int argc, char** argv)
   int ret = 0;
   FILE *vcdfile = NULL;
   bool print_cycles = false;
+  bool sim_perf = false;
+  uint64_t pc_sample_interval = 0;
+  const char *pc_sample_file = "pcprof.bin";
+  pc_sampler_t *pc_sampler = NULL;
+  topdown_t *topdown = NULL;
+  const char *topdown_file = NULL;
+  traffic_monitor_t *traffic = NULL;
+  const char *traffic_file = NULL;
+  bool traffic_enabled = false;
+  uint64_t traffic_interval = 0;
+  FILE *traffic_out = NULL;
+  stats_server_t *stats_server = NULL;
+  const char *stats_socket = NULL;
+#if VM_TRACE
+  bool dump_enabled = true;
+#endif
+  const char *record_file = NULL;
+  const char *replay_file = NULL;
+  const char *divergence_file = NULL;
+  int exit_code;
+  uint64_t max_seconds = 0;
+  uint64_t max_rss_mb = 0;
+  uint64_t heartbeat_seconds = 0;
+  run_budget_t *budget = NULL;
+  int over_budget = run_budget_t::OK;
+  uint64_t last_pc = 0;
+  std::string init_mode = "random";
+  bool seed_given = false;
   char *new_argv[argc];
   int new_argc;
 
@@ -71,9 +168,10 @@ int main(int argc, char** argv)
       vcdfile = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
       if (!vcdfile)
         abort();
-    } else if (arg.substr(0, 2) == "-s")
+    } else if (arg.substr(0, 2) == "-s") {
       random_seed = atoi(argv[i]+2);
-    else if (arg == "+verbose")
+      seed_given = true;
+    } else if (arg == "+verbose")
       verbose = true;
     else if (arg.substr(0, 12) == "+max-cycles=")
       max_cycles = atoll(argv[i]+12);
@@ -81,17 +179,82 @@ int main(int argc, char** argv)
       start = atoll(argv[i]+7);
     else if (arg.substr(0, 12) == "+cycle-count")
       print_cycles = true;
+    else if (arg == "+sim-perf")
+      sim_perf = true;
+    else if (arg.substr(0, 11) == "+pc-sample=")
+      pc_sample_interval = atoll(argv[i]+11);
+    else if (arg.substr(0, 16) == "+pc-sample-file=")
+      pc_sample_file = argv[i]+16;
+    else if (arg == "+topdown")
+      topdown = new topdown_t;
+    else if (arg.substr(0, 9) == "+topdown=") {
+      topdown = new topdown_t;
+      topdown_file = argv[i]+9;
+    }
+    else if (arg == "+traffic")
+      traffic_enabled = true;
+    else if (arg.substr(0, 9) == "+traffic=") {
+      traffic_enabled = true;
+      traffic_file = argv[i]+9;
+    }
+    else if (arg.substr(0, 18) == "+traffic-interval=")
+      traffic_interval = atoll(argv[i]+18);
+    else if (arg.substr(0, 14) == "+stats-socket=")
+      stats_socket = argv[i]+14;
+    else if (arg.substr(0, 6) == "+init=")
+      init_mode = argv[i]+6;
+    else if (arg.substr(0, 13) == "+max-seconds=")
+      max_seconds = atoll(argv[i]+13);
+    else if (arg.substr(0, 9) == "+max-rss=")
+      max_rss_mb = atoll(argv[i]+9);
+    else if (arg.substr(0, 11) == "+heartbeat=")
+      heartbeat_seconds = atoll(argv[i]+11);
+    else if (arg.substr(0, 8) == "+record=")
+      record_file = argv[i]+8;
+    else if (arg.substr(0, 8) == "+replay=")
+      replay_file = argv[i]+8;
+    else if (arg.substr(0, 19) == "+replay-divergence=")
+      divergence_file = argv[i]+19;
   }
 
+  // Seeded runs all start from the same state unless given a seed
+  if (init_mode == "seeded" && !seed_given)
+    random_seed = 0;
+
+  // A replay stands in for the front-end server, which then never runs.
+  // It also starts from the recording's random initial state.
+  if (record_file)
+    external_io_record(record_file, random_seed);
+  if (replay_file)
+    random_seed = external_io_replay(replay_file, divergence_file);
+
   if (verbose)
     fprintf(stderr, "using random seed %u\n", random_seed);
 
   srand(random_seed);
   srand48(random_seed);
 
-  Verilated::randReset(2);
+  // Initial state of every register and memory: random (the default), all
+  // zeros, which skips drawing a random number for every word of the
+  // caches and buffers and so starts up faster, or random from a fixed
+  // seed, which is the same on every run
+  if (init_mode == "zero") {
+    Verilated::randReset(0);
+  } else if (init_mode == "random" || init_mode == "seeded") {
+    Verilated::randReset(2);
+  } else {
+    fprintf(stderr, "unknown +init mode %s; use zero, random or seeded\n",
+            init_mode.c_str());
+    exit(1);
+  }
   Verilated::commandArgs(argc, argv);
+
+  run_budget_t startup(0, 0, 0);
   VTestHarness *tile = new VTestHarness;
+  if (verbose || print_cycles)
+    fprintf(stderr, "init %s: model set up in %.3f s, %lu MiB\n",
+            init_mode.c_str(), startup.elapsed(),
+            (unsigned long) run_budget_t::rss_mb());
 
 #if VM_TRACE
   Verilated::traceEverOn(true); // Verilator must compute traced signals
@@ -103,11 +266,37 @@ int main(int argc, char** argv)
   }
 #endif
 
+  if (pc_sample_interval)
+    pc_sampler = new pc_sampler_t(pc_sample_file, pc_sample_interval);
+
+  // The stats server's memory counters come from the traffic monitor, which
+  // then only prints anything if asked to
+  if (traffic_enabled || stats_socket) {
+    traffic_out = traffic_file ? fopen(traffic_file, "w") : stderr;
+    if (!traffic_out) {
+      perror(traffic_file);
+      abort();
+    }
+    traffic = new traffic_monitor_t(traffic_out,
+                                    traffic_enabled ? traffic_interval : 0);
+    traffic->add_port("mem");
+    traffic->add_port("core", CORE_TRAFFIC_TAP);
+    traffic->add_port("blkdev");
+    traffic->add_port("icenic");
+  }
+
+  if (stats_socket)
+    stats_server = new stats_server_t(stats_socket);
+
   new_argc = copy_argv(argc, argv, new_argv);
-  tsi = new tsi_t(new_argc, new_argv);
+  tsi = stats_socket ? new counting_tsi_t(new_argc, new_argv)
+                     : new tsi_t(new_argc, new_argv);
 
   signal(SIGTERM, handle_sigterm);
 
+  if (max_seconds || max_rss_mb || heartbeat_seconds)
+    budget = new run_budget_t(max_seconds, max_rss_mb, heartbeat_seconds);
+
   // reset for several cycles to handle pipelined reset
   for (int i = 0; i < 10; i++) {
     tile->reset = 1;
@@ -118,12 +307,14 @@ int main(int argc, char** argv)
     tile->reset = 0;
   }
   done_reset = true;
+  run_budget_t run_time(0, 0, 0);
 
-  while (!tsi->done() && !tile->io_success && trace_count < max_cycles) {
+  while (!tsi->done() && !tile->io_success && trace_count < max_cycles &&
+         !over_budget) {
     tile->clock = 0;
     tile->eval();
 #if VM_TRACE
-    bool dump = tfp && trace_count >= start;
+    bool dump = tfp && trace_count >= start && dump_enabled;
     if (dump)
       tfp->dump(static_cast<vluint64_t>(trace_count * 2));
 #endif
@@ -134,6 +325,44 @@ int main(int argc, char** argv)
     if (dump)
       tfp->dump(static_cast<vluint64_t>(trace_count * 2 + 1));
 #endif
+    if (tile->io_trace_valid)
+      last_pc = tile->io_trace_pc;
+    if (budget && (trace_count & 16383) == 0)
+      over_budget = budget->check(trace_count, last_pc);
+    if (pc_sampler)
+      pc_sampler->tick(tile->io_trace_valid, tile->io_trace_pc,
+                       tile->io_trace_insn);
+    if (topdown)
+      topdown->tick(tile->io_trace_valid, tile->io_trace_insn,
+                    tile->io_trace_slot);
+    if (traffic)
+      monitor_traffic(tile, traffic);
+    if (stats_server) {
+      stats.nic_tx_packets += tile->io_traffic_events_nicSend;
+      stats.nic_rx_packets += tile->io_traffic_events_nicRecv;
+      stats.blkdev_requests += tile->io_traffic_events_blkdevRequest;
+      if ((trace_count & 1023) == 0) {
+        stats.cycle = trace_count;
+        traffic->totals(0, false, stats.mem_reads, stats.mem_read_bytes);
+        traffic->totals(0, true, stats.mem_writes, stats.mem_write_bytes);
+        int actions = stats_server->poll(stats, VM_TRACE && vcdfile);
+        if (actions & stats_server_t::DUMP) {
+          stats_server->print(stderr, stats);
+          if (traffic_enabled)
+            traffic->report();
+          if (topdown)
+            topdown->report(stderr);
+        }
+#if VM_TRACE
+        if (actions & stats_server_t::TRACE_START) {
+          dump_enabled = true;
+          start = 0;
+        }
+        if (actions & stats_server_t::TRACE_STOP)
+          dump_enabled = false;
+#endif
+      }
+    }
     trace_count++;
   }
 
@@ -145,21 +374,62 @@ int main(int argc, char** argv)
   if (vcdfile)
     fclose(vcdfile);
 
-  if (tsi->exit_code())
+  exit_code = external_io_replaying() ? external_io_exit_code()
+                                      : tsi->exit_code();
+  if (external_io_close())
+    ret = 4;
+
+  if (exit_code)
   {
-    fprintf(stderr, "*** FAILED *** (code = %d, seed %d) after %ld cycles\n", tsi->exit_code(), random_seed, trace_count);
-    ret = tsi->exit_code();
+    fprintf(stderr, "*** FAILED *** (code = %d, seed %d) after %ld cycles\n", exit_code, random_seed, trace_count);
+    ret = exit_code;
   }
   else if (trace_count == max_cycles)
   {
-    fprintf(stderr, "*** FAILED *** (timeout, seed %d) after %ld cycles\n", random_seed, trace_count);
+    fprintf(stderr, "*** FAILED *** (timeout, seed %d) after %ld cycles, pc 0x%lx\n", random_seed, trace_count, last_pc);
     ret = 2;
   }
+  else if (over_budget == run_budget_t::TIME)
+  {
+    fprintf(stderr, "*** FAILED *** (wall-clock limit of %lu s, seed %d) after %ld cycles, pc 0x%lx\n", max_seconds, random_seed, trace_count, last_pc);
+    ret = 5;
+  }
+  else if (over_budget == run_budget_t::MEMORY)
+  {
+    fprintf(stderr, "*** FAILED *** (memory limit of %lu MiB, seed %d) after %ld cycles, pc 0x%lx\n", max_rss_mb, random_seed, trace_count, last_pc);
+    ret = 6;
+  }
   else if (verbose || print_cycles)
   {
     fprintf(stderr, "Completed after %ld cycles\n", trace_count);
   }
 
+  if (sim_perf)
+    print_sim_perf("verilator", trace_count, run_time.elapsed());
+
+  if (topdown) {
+    FILE *out = topdown_file ? fopen(topdown_file, "w") : stderr;
+    if (!out) {
+      perror(topdown_file);
+      abort();
+    }
+    topdown->report(out);
+    if (out != stderr)
+      fclose(out);
+  }
+
+  if (traffic) {
+    if (traffic_enabled)
+      traffic->report();
+    if (traffic_out != stderr)
+      fclose(traffic_out);
+  }
+
+  delete pc_sampler;
+  delete topdown;
+  delete traffic;
+  delete stats_server;
+  delete budget;
   delete tsi;
   delete tile;
 
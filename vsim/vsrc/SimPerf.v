@@ -0,0 +1,32 @@
+// See LICENSE for license details.
+
+// Simulation throughput for +sim-perf. This module is compiled next to the
+// test driver as a second top level. It counts the cycles after reset and
+// reports them at the end of the run through sim_perf_report, along with
+// the wall-clock time and memory use.
+
+module SimPerf;
+  import "DPI-C" function void sim_perf_start();
+  import "DPI-C" function void sim_perf_report(input longint cycles);
+
+  bit enabled = 1'b0;
+  bit started = 1'b0;
+  longint cycles = 0;
+
+  initial enabled = $test$plusargs("sim-perf");
+
+  always @(posedge `SIM_PERF_CLOCK) begin
+    if (enabled && !`SIM_PERF_RESET) begin
+      if (!started) begin
+        sim_perf_start();
+        started = 1'b1;
+      end
+      cycles = cycles + 1;
+    end
+  end
+
+  final begin
+    if (enabled)
+      sim_perf_report(cycles);
+  end
+endmodule